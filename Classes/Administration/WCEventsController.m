@@ -727,7 +727,7 @@ typedef enum _WCEventType		WCEventType;
 		
 		message = [WIP7Message messageWithName:@"wired.event.get_events" spec:WCP7Spec];
 		[message setUInt32:1000 forName:@"wired.event.last_event_count"];
-		[[_administration connection] sendMessage:message fromObserver:self selector:@selector(wiredEventGetEventsReply:)];
+		[[_administration connection] sendMessage:message fromObserver:self batchSelector:@selector(wiredEventGetEventsReplies:)];
 		
 		message = [WIP7Message messageWithName:@"wired.event.subscribe" spec:WCP7Spec];
 		[[_administration connection] sendMessage:message fromObserver:self selector:@selector(wiredEventSubscribeReply:)];
@@ -912,6 +912,17 @@ typedef enum _WCEventType		WCEventType;
 
 
 
+- (void)wiredEventGetEventsReplies:(NSArray *)messages {
+	NSUInteger		i, count;
+	
+	count = [messages count];
+	
+	for(i = 0; i < count; i++)
+		[self wiredEventGetEventsReply:[messages objectAtIndex:i]];
+}
+
+
+
 - (void)wiredEventSubscribeReply:(WIP7Message *)message {
 	if([[message name] isEqualToString:@"wired.okay"]) {
 		[[_administration connection] removeObserver:self message:message];
@@ -973,7 +984,7 @@ typedef enum _WCEventType		WCEventType;
 		message = [WIP7Message messageWithName:@"wired.event.get_events" spec:WCP7Spec];
 		[message setDate:date forName:@"wired.event.from_time"];
 		[message setUInt32:7 forName:@"wired.event.number_of_days"];
-		[[_administration connection] sendMessage:message fromObserver:self selector:@selector(wiredEventGetEventsReply:)];
+		[[_administration connection] sendMessage:message fromObserver:self batchSelector:@selector(wiredEventGetEventsReplies:)];
 	}
 }
 
@@ -26,6 +26,19 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#define WCLinkWriteSpace				32768
+
+
+struct _WCLinkSendStatistics {
+	NSUInteger				queuedMessages;
+	NSUInteger				peakQueuedMessages;
+	NSUInteger				writtenMessages;
+	NSTimeInterval			writeLatency;
+	NSTimeInterval			maximumWriteLatency;
+};
+typedef struct _WCLinkSendStatistics	WCLinkSendStatistics;
+
+
 @interface WCLink : WIObject {
 	WISocket				*_socket;
 	WIP7Socket				*_p7Socket;
@@ -36,12 +49,32 @@
 	
 	NSLock					*_lock;
 	
+	NSUInteger				_readLength;
+	NSUInteger				_checksumLength;
+	WIError					*_frameError;
+	BOOL					_readingFrame;
+	
+	NSMutableArray			*_receivedMessages;
+	NSMutableArray			*_receivedRoutes;
+	NSMutableArray			*_deliveredMessages;
+	NSMutableArray			*_deliveredRoutes;
+	NSUInteger				_deliveredIndex;
+	OSSpinLock				_receivedLock;
+	BOOL					_delivering;
+	
+	NSMutableArray			*_sendQueue;
+	OSSpinLock				_sendLock;
+	WCLinkSendStatistics	_sendStatistics;
+	
 	id						_delegate;
 	BOOL					_delegateLinkConnected;
 	BOOL					_delegateLinkClosed;
 	BOOL					_delegateLinkTerminated;
 	BOOL					_delegateLinkSentCommand;
 	BOOL					_delegateLinkReceivedMessage;
+	BOOL					_delegateLinkReceivedMessages;
+	BOOL					_delegateLinkReceivedInvalidMessage;
+	BOOL					_delegateLinkRouteForMessage;
 	
 	BOOL					_reading;
 	BOOL					_closing;
@@ -61,6 +94,22 @@
 - (void)disconnect;
 - (void)terminate;
 - (void)sendMessage:(WIP7Message *)message;
+- (void)sendMessage:(WIP7Message *)message target:(id)target selector:(SEL)selector;
+- (void)getSendStatistics:(WCLinkSendStatistics *)statistics;
+
+@end
+
+
+@interface WCLink(WCLinkReactor)
+
+- (int)descriptor;
+- (BOOL)isClosing;
+- (BOOL)isReadingFrame;
+- (BOOL)readMessagesAtEndOfFile:(BOOL)eof error:(WIError **)error;
+- (BOOL)finishReadingFrameWithError:(WIError **)error;
+- (BOOL)hasQueuedMessages;
+- (BOOL)writeMessagesWithError:(WIError **)error;
+- (void)closeWithError:(WIError *)error;
 
 @end
 
@@ -72,5 +121,9 @@
 - (void)linkTerminated:(WCLink *)link;
 - (void)link:(WCLink *)link sentMessage:(WIP7Message *)message;
 - (void)link:(WCLink *)link receivedMessage:(WIP7Message *)message;
+- (void)link:(WCLink *)link receivedMessages:(NSArray *)messages route:(id)route;
+
+- (void)link:(WCLink *)link receivedInvalidMessage:(WIP7Message *)message error:(WIError *)error;
+- (id)link:(WCLink *)link routeForMessage:(WIP7Message *)message;
 
 @end
@@ -26,87 +26,323 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <sys/ioctl.h>
+
 #import "WCApplicationController.h"
 #import "WCConnection.h"
 #import "WCLink.h"
+#import "WCLinkReactor.h"
 
-@interface WCLink(Private)
+#define WCLinkMessagesPerWakeup			32
+#define WCLinkFrameHeaderLength			4
+#define WCLinkSHA1ChecksumLength		20
+#define WCLinkMessagesPerDelivery		100
+#define WCLinkDeliveryInterval			0.02
 
-- (BOOL)_messageLoopWithError:(WIError **)error;
+#define WCLinkSendMessageKey			@"WCLinkSendMessageKey"
+#define WCLinkSendTargetKey				@"WCLinkSendTargetKey"
+#define WCLinkSendSelectorKey			@"WCLinkSendSelectorKey"
+#define WCLinkSendTimeKey				@"WCLinkSendTimeKey"
+
+@interface WCLink(Private)
 
 - (void)_schedulePingTimer;
 - (void)_invalidatePingTimer;
 
+- (void)_receiveMessage:(WIP7Message *)message route:(id)route;
+- (BOOL)_deliverMessagesBeforeTime:(NSTimeInterval)time;
+- (void)_deliverMessages;
+- (void)_deliverAllMessages;
+- (void)_closeWithError:(WIError *)error;
+
+- (BOOL)_hasFramedMessage;
+- (BOOL)_hasOversizedMessage;
+- (BOOL)_hasWriteSpace;
+
+- (WIP7Message *)_readMessageWithError:(WIError **)error;
+- (void)_receiveReadMessage:(WIP7Message *)message;
+
+- (NSDictionary *)_dequeueMessage;
+- (void)_finishSendingMessage:(NSDictionary *)entry error:(WIError *)error;
+
 @end
 
 
 @implementation WCLink(Private)
 
-- (BOOL)_messageLoopWithError:(WIError **)outError {
-	NSAutoreleasePool		*pool;
-	WIP7Message				*message;
-	WIError					*error;
-	BOOL					state;
-	NSUInteger				i = 0;
-	NSInteger				code;
+- (void)_schedulePingTimer {
+	_pingTimer = [[NSTimer scheduledTimerWithTimeInterval:60.0
+												   target:self
+												 selector:@selector(pingTimer:)
+												 userInfo:NULL
+												  repeats:YES] retain];
+}
+
+
+
+- (void)_invalidatePingTimer {
+	[_pingTimer invalidate];
+}
+
+
+
+#pragma mark -
+
+- (void)_receiveMessage:(WIP7Message *)message route:(id)route {
+	BOOL		deliver;
 	
-	pool = [[NSAutoreleasePool alloc] init];
+	OSSpinLockLock(&_receivedLock);
+	
+	[_receivedMessages addObject:message];
+	[_receivedRoutes addObject:route ? route : [NSNull null]];
+	
+	deliver = !_delivering;
+	_delivering = YES;
+	
+	OSSpinLockUnlock(&_receivedLock);
+	
+	if(deliver)
+		[self performSelectorOnMainThread:@selector(_deliverMessages)];
+}
 
-	while(!_closing && !_terminating) {
-		if(++i % 100 == 0) {
-			[pool release];
-			pool = [[NSAutoreleasePool alloc] init];
+
+
+- (BOOL)_deliverMessagesBeforeTime:(NSTimeInterval)time {
+	NSMutableArray		*messages, *routes;
+	NSArray				*batch;
+	id					route;
+	NSUInteger			i, count;
+	BOOL				delivering;
+	
+	do {
+		if(_deliveredIndex == [_deliveredMessages count]) {
+			[_deliveredMessages removeAllObjects];
+			[_deliveredRoutes removeAllObjects];
+			_deliveredIndex = 0;
+			
+			OSSpinLockLock(&_receivedLock);
+			
+			messages			= _receivedMessages;
+			routes				= _receivedRoutes;
+			_receivedMessages	= _deliveredMessages;
+			_receivedRoutes		= _deliveredRoutes;
+			_deliveredMessages	= messages;
+			_deliveredRoutes	= routes;
+			delivering			= ([_deliveredMessages count] > 0);
+			_delivering			= delivering;
+			
+			OSSpinLockUnlock(&_receivedLock);
+			
+			if(!delivering)
+				return NO;
+		}
+		
+		route = [_deliveredRoutes objectAtIndex:_deliveredIndex];
+		count = MIN(WCLinkMessagesPerDelivery, [_deliveredMessages count] - _deliveredIndex);
+		
+		for(i = 1; i < count; i++) {
+			if(![[_deliveredRoutes objectAtIndex:_deliveredIndex + i] isEqual:route])
+				break;
+		}
+		
+		count = i;
+		batch = [_deliveredMessages subarrayWithRange:NSMakeRange(_deliveredIndex, count)];
+		
+		_deliveredIndex += count;
+		
+		if(_delegateLinkReceivedMessages) {
+			[_delegate link:self receivedMessages:batch route:(route == [NSNull null]) ? NULL : route];
+		}
+		else if(_delegateLinkReceivedMessage) {
+			for(i = 0; i < count; i++)
+				[_delegate link:self receivedMessage:[batch objectAtIndex:i]];
 		}
+	} while([NSDate timeIntervalSinceReferenceDate] < time);
+	
+	return YES;
+}
+
+
+
+- (void)_deliverMessages {
+	if([self _deliverMessagesBeforeTime:[NSDate timeIntervalSinceReferenceDate] + WCLinkDeliveryInterval])
+		[self performSelector:@selector(_deliverMessages) withObject:NULL afterDelay:0.0];
+}
+
 
-		do {
-			state = [_socket waitWithTimeout:0.1];
-		} while(!state && !_closing && !_terminating);
+
+- (void)_deliverAllMessages {
+	[self _deliverMessagesBeforeTime:DBL_MAX];
+}
+
+
+
+- (void)_closeWithError:(WIError *)error {
+	[self _deliverAllMessages];
+	[self _invalidatePingTimer];
+	
+	if(_terminating) {
+		if(_delegateLinkTerminated)
+			[_delegate linkTerminated:self];
+	} else {
+		if(_delegateLinkClosed)
+			[_delegate linkClosed:self error:error];
+	}
+	
+	[_lock lock];
+	
+	[_p7Socket release];
+	[_socket release];
+	
+	_p7Socket = NULL;
+	_socket = NULL;
+	
+	[_lock unlock];
+}
+
+
+
+#pragma mark -
+
+- (BOOL)_hasFramedMessage {
+	uint32_t		length;
+	socklen_t		optionLength;
+	int				descriptor, available, size;
+	
+	descriptor = [self descriptor];
+	
+	if(ioctl(descriptor, FIONREAD, &available) < 0)
+		return NO;
+	
+	if(_readLength == 0) {
+		if(available < WCLinkFrameHeaderLength)
+			return NO;
 		
-		if(_closing || _terminating)
-			break;
+		if(recv(descriptor, &length, sizeof(length), MSG_PEEK) != sizeof(length))
+			return NO;
 		
-		[_lock lock];
-		message = [_p7Socket readMessageWithTimeout:10.0 error:&error];
-		[_lock unlock];
+		_readLength = WCLinkFrameHeaderLength + ntohl(length) + _checksumLength;
 		
-		if(!message) {
-			code = [[[error userInfo] objectForKey:WILibWiredErrorKey] code];
-			
-			if(code == ETIMEDOUT)
-				continue;
-			else if(code == WI_ERROR_SOCKET_EOF)
-				*outError = [[WCError alloc] initWithDomain:WCWiredClientErrorDomain code:WCWiredClientServerDisconnected];
-			else
-				*outError = [error retain];
+		optionLength = sizeof(size);
+		
+		if(getsockopt(descriptor, SOL_SOCKET, SO_RCVBUF, &size, &optionLength) == 0 && (NSUInteger) size < _readLength) {
+			size = _readLength;
 			
-			break;
+			setsockopt(descriptor, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
 		}
+	}
+	
+	return ((NSUInteger) available >= _readLength);
+}
+
+
+
+- (BOOL)_hasOversizedMessage {
+	socklen_t		optionLength;
+	int				size;
+	
+	if(_readLength == 0)
+		return NO;
+	
+	optionLength = sizeof(size);
+	
+	return (getsockopt([self descriptor], SOL_SOCKET, SO_RCVBUF, &size, &optionLength) == 0 && (NSUInteger) size < _readLength);
+}
+
+
+
+- (BOOL)_hasWriteSpace {
+	socklen_t		optionLength;
+	int				descriptor, size, unsent;
+	
+	descriptor = [self descriptor];
+	optionLength = sizeof(size);
+	
+	if(getsockopt(descriptor, SOL_SOCKET, SO_SNDBUF, &size, &optionLength) < 0)
+		return NO;
+	
+	optionLength = sizeof(unsent);
+	
+	if(getsockopt(descriptor, SOL_SOCKET, SO_NWRITE, &unsent, &optionLength) < 0)
+		return NO;
+	
+	return (size - unsent >= WCLinkWriteSpace);
+}
+
+
+
+#pragma mark -
+
+- (WIP7Message *)_readMessageWithError:(WIError **)error {
+	WIP7Message		*message;
+	NSInteger		code;
+	
+	[_lock lock];
+	message = [_p7Socket readMessageWithTimeout:30.0 error:error];
+	[_lock unlock];
+	
+	_readLength = 0;
+	
+	if(!message) {
+		code = [[[*error userInfo] objectForKey:WILibWiredErrorKey] code];
 		
-		if(_delegateLinkReceivedMessage)
-			[_delegate performSelectorOnMainThread:@selector(link:receivedMessage:) withObject:self withObject:message];
+		if(code == WI_ERROR_SOCKET_EOF)
+			*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientServerDisconnected];
 	}
 	
-	[pool release];
+	return message;
+}
+
+
+
+- (void)_receiveReadMessage:(WIP7Message *)message {
+	WIError		*error;
 	
-	return NO;
+	if(![_p7Socket verifyMessage:message error:&error]) {
+		if(_delegateLinkReceivedInvalidMessage)
+			[_delegate link:self receivedInvalidMessage:message error:error];
+		
+		return;
+	}
+	
+	if(_delegateLinkReceivedMessage || _delegateLinkReceivedMessages)
+		[self _receiveMessage:message route:_delegateLinkRouteForMessage ? [_delegate link:self routeForMessage:message] : NULL];
 }
 
 
 
 #pragma mark -
 
-- (void)_schedulePingTimer {
-	_pingTimer = [[NSTimer scheduledTimerWithTimeInterval:60.0
-												   target:self
-												 selector:@selector(pingTimer:)
-												 userInfo:NULL
-												  repeats:YES] retain];
+- (NSDictionary *)_dequeueMessage {
+	NSDictionary	*entry = NULL;
+	
+	OSSpinLockLock(&_sendLock);
+	
+	if([_sendQueue count] > 0) {
+		entry = [[[_sendQueue objectAtIndex:0] retain] autorelease];
+		
+		[_sendQueue removeObjectAtIndex:0];
+		
+		_sendStatistics.queuedMessages = [_sendQueue count];
+	}
+	
+	OSSpinLockUnlock(&_sendLock);
+	
+	return entry;
 }
 
 
 
-- (void)_invalidatePingTimer {
-	[_pingTimer invalidate];
+- (void)_finishSendingMessage:(NSDictionary *)entry error:(WIError *)error {
+	id		target;
+	
+	target = [entry objectForKey:WCLinkSendTargetKey];
+	
+	if(target) {
+		[target performSelectorOnMainThread:NSSelectorFromString([entry objectForKey:WCLinkSendSelectorKey])
+								 withObject:[entry objectForKey:WCLinkSendMessageKey]
+								 withObject:error];
+	}
 }
 
 @end
@@ -121,6 +357,15 @@
 	_pingMessage	= [[WIP7Message alloc] initWithName:@"wired.send_ping" spec:WCP7Spec];
 	_lock			= [[NSLock alloc] init];
 	
+	_receivedMessages	= [[NSMutableArray alloc] init];
+	_receivedRoutes		= [[NSMutableArray alloc] init];
+	_deliveredMessages	= [[NSMutableArray alloc] init];
+	_deliveredRoutes	= [[NSMutableArray alloc] init];
+	_receivedLock		= OS_SPINLOCK_INIT;
+	
+	_sendQueue			= [[NSMutableArray alloc] init];
+	_sendLock			= OS_SPINLOCK_INIT;
+	
 	return self;
 }
 
@@ -131,6 +376,12 @@
 	[_pingTimer release];
 	[_pingMessage release];
 	[_lock release];
+	[_receivedMessages release];
+	[_receivedRoutes release];
+	[_deliveredMessages release];
+	[_deliveredRoutes release];
+	[_sendQueue release];
+	[_frameError release];
 	
 	[super dealloc];
 }
@@ -140,13 +391,16 @@
 #pragma mark -
 
 - (void)setDelegate:(id)delegate {
-	_delegate						= delegate;
+	_delegate								= delegate;
 	
-	_delegateLinkConnected			= [_delegate respondsToSelector:@selector(linkConnected:)];
-	_delegateLinkClosed				= [_delegate respondsToSelector:@selector(linkClosed:error:)];
-	_delegateLinkTerminated			= [_delegate respondsToSelector:@selector(linkTerminated:)];
-	_delegateLinkSentCommand		= [_delegate respondsToSelector:@selector(link:sentMessage:)];
-	_delegateLinkReceivedMessage	= [_delegate respondsToSelector:@selector(link:receivedMessage:)];
+	_delegateLinkConnected					= [_delegate respondsToSelector:@selector(linkConnected:)];
+	_delegateLinkClosed						= [_delegate respondsToSelector:@selector(linkClosed:error:)];
+	_delegateLinkTerminated					= [_delegate respondsToSelector:@selector(linkTerminated:)];
+	_delegateLinkSentCommand				= [_delegate respondsToSelector:@selector(link:sentMessage:)];
+	_delegateLinkReceivedMessage			= [_delegate respondsToSelector:@selector(link:receivedMessage:)];
+	_delegateLinkReceivedMessages			= [_delegate respondsToSelector:@selector(link:receivedMessages:route:)];
+	_delegateLinkReceivedInvalidMessage		= [_delegate respondsToSelector:@selector(link:receivedInvalidMessage:error:)];
+	_delegateLinkRouteForMessage			= [_delegate respondsToSelector:@selector(link:routeForMessage:)];
 }
 
 
@@ -183,6 +437,8 @@
 	_reading = YES;
 	_terminating = NO;
 	
+	[WCLinkReactor reactor];
+	
 	[WIThread detachNewThreadSelector:@selector(linkThread:) toTarget:self withObject:NULL];
 }
 
@@ -191,6 +447,8 @@
 - (void)disconnect {
 	_closing = YES;
 	_reading = NO;
+	
+	[[WCLinkReactor reactor] wakeUp];
 }
 
 
@@ -198,17 +456,70 @@
 - (void)terminate {
 	_terminating = YES;
 	_reading = NO;
+	
+	[[WCLinkReactor reactor] wakeUp];
 }
 
 
 
 - (void)sendMessage:(WIP7Message *)message {
-	[_lock lock];
-	[_p7Socket writeMessage:message timeout:0.0 error:NULL];
-	[_lock unlock];
+	[self sendMessage:message target:NULL selector:NULL];
+}
+
+
+
+- (void)sendMessage:(WIP7Message *)message target:(id)target selector:(SEL)selector {
+	NSMutableDictionary		*entry;
+	BOOL					wake;
+	
+	entry = [NSMutableDictionary dictionaryWithObjectsAndKeys:
+		message,
+			WCLinkSendMessageKey,
+		[NSNumber numberWithDouble:[NSDate timeIntervalSinceReferenceDate]],
+			WCLinkSendTimeKey,
+		NULL];
+	
+	if(target) {
+		[entry setObject:target forKey:WCLinkSendTargetKey];
+		[entry setObject:NSStringFromSelector(selector) forKey:WCLinkSendSelectorKey];
+	}
+	
+	if(!_reading) {
+		[self _finishSendingMessage:entry error:[WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientServerDisconnected]];
+		
+		return;
+	}
+	
+	OSSpinLockLock(&_sendLock);
+	
+	wake = ([_sendQueue count] == 0);
+	
+	[_sendQueue addObject:entry];
+	
+	_sendStatistics.queuedMessages = [_sendQueue count];
+	
+	if(_sendStatistics.queuedMessages > _sendStatistics.peakQueuedMessages)
+		_sendStatistics.peakQueuedMessages = _sendStatistics.queuedMessages;
+	
+	OSSpinLockUnlock(&_sendLock);
+	
+	if(wake)
+		[[WCLinkReactor reactor] addWritingLink:self];
+}
+
+
+
+- (void)getSendStatistics:(WCLinkSendStatistics *)statistics {
+	OSSpinLockLock(&_sendLock);
+	
+	*statistics = _sendStatistics;
 	
-	if(_delegateLinkSentCommand)
-		[_delegate link:self sentMessage:message];
+	_sendStatistics.peakQueuedMessages		= _sendStatistics.queuedMessages;
+	_sendStatistics.writtenMessages			= 0;
+	_sendStatistics.writeLatency			= 0.0;
+	_sendStatistics.maximumWriteLatency		= 0.0;
+	
+	OSSpinLockUnlock(&_sendLock);
 }
 
 
@@ -216,9 +527,10 @@
 #pragma mark -
 
 - (void)linkThread:(id)arg {
-	NSAutoreleasePool	*pool, *loopPool = NULL;
+	NSAutoreleasePool	*pool;
 	WIError				*error = NULL;
 	WIAddress			*address;
+	int					size;
 
 	pool = [[NSAutoreleasePool alloc] init];
 	
@@ -232,6 +544,10 @@
 		[_socket setDirection:WISocketRead];
 		
 		if([_socket connectWithTimeout:30.0 error:&error]) {
+			size = 4 * WCLinkWriteSpace;
+			
+			setsockopt([self descriptor], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
 			_p7Socket = [[WIP7Socket alloc] initWithSocket:_socket spec:WCP7Spec];
 
 			if([_p7Socket connectWithOptions:WIP7EncryptionRSA_AES256_SHA1 | WIP7ChecksumSHA1 | WIP7CompressionDeflate
@@ -240,39 +556,47 @@
 									password:[[_url password] SHA1]
 									 timeout:30.0
 									   error:&error]) {
+				_checksumLength = ([_p7Socket options] & WIP7ChecksumSHA1) ? WCLinkSHA1ChecksumLength : 0;
+				
 				if(_delegateLinkConnected)
 					[_delegate performSelectorOnMainThread:@selector(linkConnected:) withObject:self];
 				
 				[self performSelectorOnMainThread:@selector(_schedulePingTimer)];
-
-				[self _messageLoopWithError:&error];
-
-				[self performSelectorOnMainThread:@selector(_invalidatePingTimer)];
+				
+				[[WCLinkReactor reactor] addLink:self];
+				
+				[pool release];
+				
+				return;
 			}
 		}
 	}
 	
-	if(_terminating) {
-		if(_delegateLinkTerminated)
-			[_delegate performSelectorOnMainThread:@selector(linkTerminated:) withObject:self waitUntilDone:YES];
-	} else {
-		if(_delegateLinkClosed)
-			[_delegate performSelectorOnMainThread:@selector(linkClosed:error:) withObject:self withObject:error waitUntilDone:YES];
-	}
-	
-	_reading = NO;
+	[self closeWithError:error];
 	
-	[_lock lock];
+	[pool release];
+}
 
-	[_p7Socket release];
-	[_socket release];
+
+
+- (void)frameThread:(id)arg {
+	NSAutoreleasePool	*pool;
+	WIP7Message			*message;
+	WIError				*error;
 	
-	_p7Socket = NULL;
-	_socket = NULL;
+	pool = [[NSAutoreleasePool alloc] init];
 	
-	[_lock unlock];
+	message = [self _readMessageWithError:&error];
+	
+	if(message)
+		[self _receiveReadMessage:message];
+	else
+		_frameError = [error retain];
+	
+	_readingFrame = NO;
+	
+	[[WCLinkReactor reactor] resumeReadingLink:self];
 	
-	[loopPool release];
 	[pool release];
 }
 
@@ -283,3 +607,152 @@
 }
 
 @end
+
+
+
+@implementation WCLink(WCLinkReactor)
+
+- (int)descriptor {
+	return wi_socket_descriptor([_socket socket]);
+}
+
+
+
+- (BOOL)isClosing {
+	return (_closing || _terminating);
+}
+
+
+
+- (BOOL)isReadingFrame {
+	return _readingFrame;
+}
+
+
+
+- (BOOL)readMessagesAtEndOfFile:(BOOL)eof error:(WIError **)outError {
+	WIP7Message		*message;
+	NSUInteger		i;
+	
+	for(i = 0; i < WCLinkMessagesPerWakeup; i++) {
+		if(![self _hasFramedMessage]) {
+			if(eof) {
+				*outError = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientServerDisconnected];
+				
+				return NO;
+			}
+			
+			/* A frame larger than the largest receive buffer is read on its own thread */
+			if([self _hasOversizedMessage]) {
+				_readingFrame = YES;
+				
+				[WIThread detachNewThreadSelector:@selector(frameThread:) toTarget:self withObject:NULL];
+			}
+			
+			break;
+		}
+		
+		message = [self _readMessageWithError:outError];
+		
+		if(!message)
+			return NO;
+		
+		[self _receiveReadMessage:message];
+	}
+	
+	return YES;
+}
+
+
+
+- (BOOL)finishReadingFrameWithError:(WIError **)error {
+	if(!_frameError)
+		return YES;
+	
+	*error = [_frameError autorelease];
+	_frameError = NULL;
+	
+	return NO;
+}
+
+
+
+- (BOOL)hasQueuedMessages {
+	BOOL		queued;
+	
+	OSSpinLockLock(&_sendLock);
+	queued = ([_sendQueue count] > 0);
+	OSSpinLockUnlock(&_sendLock);
+	
+	return queued;
+}
+
+
+
+- (BOOL)writeMessagesWithError:(WIError **)outError {
+	NSDictionary		*entry;
+	WIError				*error;
+	NSTimeInterval		latency;
+	NSUInteger			i;
+	BOOL				result;
+	
+	if(_readingFrame)
+		return YES;
+	
+	for(i = 0; i < WCLinkMessagesPerWakeup; i++) {
+		if(![self _hasWriteSpace])
+			break;
+		
+		entry = [self _dequeueMessage];
+		
+		if(!entry)
+			break;
+		
+		[_lock lock];
+		result = [_p7Socket writeMessage:[entry objectForKey:WCLinkSendMessageKey] timeout:0.0 error:&error];
+		[_lock unlock];
+		
+		if(!result) {
+			[self _finishSendingMessage:entry error:error];
+			
+			*outError = error;
+			
+			return NO;
+		}
+		
+		latency = [NSDate timeIntervalSinceReferenceDate] - [[entry objectForKey:WCLinkSendTimeKey] doubleValue];
+		
+		OSSpinLockLock(&_sendLock);
+		
+		_sendStatistics.writtenMessages++;
+		_sendStatistics.writeLatency += latency;
+		
+		if(latency > _sendStatistics.maximumWriteLatency)
+			_sendStatistics.maximumWriteLatency = latency;
+		
+		OSSpinLockUnlock(&_sendLock);
+		
+		if(_delegateLinkSentCommand)
+			[_delegate performSelectorOnMainThread:@selector(link:sentMessage:) withObject:self withObject:[entry objectForKey:WCLinkSendMessageKey]];
+		
+		[self _finishSendingMessage:entry error:NULL];
+	}
+	
+	return YES;
+}
+
+
+
+- (void)closeWithError:(WIError *)error {
+	NSDictionary		*entry;
+	
+	_reading = NO;
+	_readLength = 0;
+	
+	while((entry = [self _dequeueMessage]))
+		[self _finishSendingMessage:entry error:[WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientServerDisconnected]];
+	
+	[self performSelectorOnMainThread:@selector(_closeWithError:) withObject:error];
+}
+
+@end
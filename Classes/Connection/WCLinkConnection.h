@@ -42,12 +42,16 @@ extern NSString * const WCLinkConnectionSentMessageNotification;
 extern NSString * const WCLinkConnectionLoggedInNotification;
 
 
-@class WCLink, WCNotificationCenter;
+@class WCLink, WCNotificationCenter, WCTransactionTracer;
 
 @interface WCLinkConnection : WCConnection {
 	WCLink								*_link;
 	NSNotificationCenter				*_notificationCenter;
-	WIP7NotificationCenter				*_linkNotificationCenter;
+	NSMutableDictionary					*_transactionObservers;
+	NSMutableDictionary					*_nameObservers;
+	NSLock								*_observersLock;
+	
+	WCTransactionTracer					*_tracer;
 	WIP7UInt32							_transaction;
 	
 	WCError								*_error;
@@ -75,10 +79,12 @@ extern NSString * const WCLinkConnectionLoggedInNotification;
 
 - (NSUInteger)sendMessage:(WIP7Message *)message;
 - (NSUInteger)sendMessage:(WIP7Message *)message fromObserver:(id)observer selector:(SEL)selector;
+- (NSUInteger)sendMessage:(WIP7Message *)message fromObserver:(id)observer batchSelector:(SEL)selector;
 - (void)replyMessage:(WIP7Message *)message toMessage:(WIP7Message *)message;
 
 - (BOOL)isConnected;
 - (BOOL)isDisconnecting;
 - (WCError *)error;
+- (WCTransactionTracer *)transactionTracer;
 
 @end
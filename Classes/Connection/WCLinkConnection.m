@@ -28,6 +28,7 @@
 
 #import "WCLink.h"
 #import "WCLinkConnection.h"
+#import "WCTransactionTracer.h"
 
 NSString * const WCLinkConnectionWillConnectNotification				= @"WCLinkConnectionWillConnectNotification";
 NSString * const WCLinkConnectionDidConnectNotification					= @"WCLinkConnectionDidConnectNotification";
@@ -43,6 +44,98 @@ NSString * const WCLinkConnectionSentMessageNotification				= @"WCLinkConnection
 NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLoggedInNotification";
 
 
+@interface _WCLinkConnectionObserver : NSObject {
+@public
+	id										observer;
+	SEL										selector;
+	BOOL									batch;
+	BOOL									removed;
+}
+
+@end
+
+
+@implementation _WCLinkConnectionObserver
+
+@end
+
+
+
+@interface WCLinkConnection(Private)
+
+- (void)_addObserver:(id)observer selector:(SEL)selector batch:(BOOL)batch transaction:(WIP7UInt32)transaction;
+- (void)_removeObserver:(id)observer fromObservers:(NSMutableArray *)observers;
+- (void)_postNotificationForMessage:(WIP7Message *)message;
+- (void)_postMessage:(WIP7Message *)message toObservers:(NSArray *)observers;
+
+@end
+
+
+@implementation WCLinkConnection(Private)
+
+- (void)_addObserver:(id)observer selector:(SEL)selector batch:(BOOL)batch transaction:(WIP7UInt32)transaction {
+	_WCLinkConnectionObserver		*entry;
+	
+	entry = [[_WCLinkConnectionObserver alloc] init];
+	entry->observer		= observer;
+	entry->selector		= selector;
+	entry->batch		= batch;
+	
+	[_observersLock lock];
+	[_transactionObservers setObject:entry forKey:[NSNumber numberWithUnsignedInt:transaction]];
+	[_observersLock unlock];
+	
+	[entry release];
+}
+
+
+
+- (void)_removeObserver:(id)observer fromObservers:(NSMutableArray *)observers {
+	_WCLinkConnectionObserver		*entry;
+	NSUInteger						i;
+	
+	for(i = 0; i < [observers count]; i++) {
+		entry = [observers objectAtIndex:i];
+		
+		if(entry->observer == observer) {
+			entry->removed = YES;
+			
+			[observers removeObjectAtIndex:i];
+			
+			i--;
+		}
+	}
+}
+
+
+
+- (void)_postNotificationForMessage:(WIP7Message *)message {
+	if([[message name] isEqualToString:@"wired.error"])
+		[_notificationCenter postNotificationName:WCLinkConnectionReceivedErrorMessageNotification object:message];
+	else
+		[_notificationCenter postNotificationName:WCLinkConnectionReceivedMessageNotification object:message];
+}
+
+
+
+- (void)_postMessage:(WIP7Message *)message toObservers:(NSArray *)observers {
+	_WCLinkConnectionObserver		*observer;
+	NSUInteger						i, count;
+	
+	count = [observers count];
+	
+	for(i = 0; i < count; i++) {
+		observer = [observers objectAtIndex:i];
+		
+		if(!observer->removed)
+			[observer->observer performSelector:observer->selector withObject:message];
+	}
+}
+
+@end
+
+
+
 @implementation WCLinkConnection
 
 - (id)init {
@@ -50,8 +143,11 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 	
 	_notificationCenter = [[NSNotificationCenter alloc] init];
 	
-	_linkNotificationCenter = [[WIP7NotificationCenter alloc] init];
-	[_linkNotificationCenter setTransactionFieldName:@"wired.transaction"];
+	_transactionObservers = [[NSMutableDictionary alloc] init];
+	_nameObservers = [[NSMutableDictionary alloc] init];
+	_observersLock = [[NSLock alloc] init];
+	
+	_tracer = [[WCTransactionTracer alloc] init];
 	
 	[self addObserver:self
 			 selector:@selector(linkConnectionDidConnect:)
@@ -79,7 +175,10 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 	
 	[_link release];
 	[_notificationCenter release];
-	[_linkNotificationCenter release];
+	[_transactionObservers release];
+	[_nameObservers release];
+	[_observersLock release];
+	[_tracer release];
 
 	[_error release];
 	
@@ -145,14 +244,60 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 
 
 - (void)addObserver:(id)observer selector:(SEL)action messageName:(NSString *)messageName {
-	[_linkNotificationCenter addObserver:observer selector:action messageName:messageName];
+	_WCLinkConnectionObserver		*entry;
+	NSMutableArray					*observers;
+	
+	entry = [[_WCLinkConnectionObserver alloc] init];
+	entry->observer		= observer;
+	entry->selector		= action;
+	
+	[_observersLock lock];
+	
+	observers = [_nameObservers objectForKey:messageName];
+	
+	if(!observers) {
+		observers = [NSMutableArray array];
+		
+		[_nameObservers setObject:observers forKey:messageName];
+	}
+	
+	[observers addObject:entry];
+	
+	[_observersLock unlock];
+	
+	[entry release];
 }
 
 
 
 - (void)removeObserver:(id)observer {
+	NSEnumerator					*enumerator;
+	NSNumber						*transaction;
+	NSMutableArray					*observers;
+	_WCLinkConnectionObserver		*entry;
+	
 	[_notificationCenter removeObserver:observer];
-	[_linkNotificationCenter removeObserver:observer];
+	
+	[_observersLock lock];
+	
+	enumerator = [[_transactionObservers allKeys] objectEnumerator];
+	
+	while((transaction = [enumerator nextObject])) {
+		entry = [_transactionObservers objectForKey:transaction];
+		
+		if(entry->observer == observer) {
+			entry->removed = YES;
+			
+			[_transactionObservers removeObjectForKey:transaction];
+		}
+	}
+	
+	enumerator = [_nameObservers objectEnumerator];
+	
+	while((observers = [enumerator nextObject]))
+		[self _removeObserver:observer fromObservers:observers];
+	
+	[_observersLock unlock];
 }
 
 
@@ -164,13 +309,33 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 
 
 - (void)removeObserver:(id)observer messageName:(NSString *)messageName {
-	[_linkNotificationCenter removeObserver:observer messageName:messageName];
+	[_observersLock lock];
+	[self _removeObserver:observer fromObservers:[_nameObservers objectForKey:messageName]];
+	[_observersLock unlock];
 }
 
 
 
 - (void)removeObserver:(id)observer message:(WIP7Message *)message {
-	[_linkNotificationCenter removeObserver:observer message:message];
+	_WCLinkConnectionObserver		*entry;
+	NSNumber						*key;
+	WIP7UInt32						transaction;
+	
+	if([message getUInt32:&transaction forName:@"wired.transaction"]) {
+		key = [NSNumber numberWithUnsignedInt:transaction];
+		
+		[_observersLock lock];
+		
+		entry = [_transactionObservers objectForKey:key];
+		
+		if(entry && entry->observer == observer) {
+			entry->removed = YES;
+			
+			[_transactionObservers removeObjectForKey:key];
+		}
+		
+		[_observersLock unlock];
+	}
 }
 
 
@@ -208,6 +373,8 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 	
 	[message setUInt32:transaction forName:@"wired.transaction"];
 	
+	[_tracer sentMessage:message transaction:transaction];
+	
 	[_link sendMessage:message];
 	
 	return transaction;
@@ -222,7 +389,26 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 	
 	[message setUInt32:transaction forName:@"wired.transaction"];
 	
-	[_linkNotificationCenter addObserver:observer selector:selector message:message];
+	[_tracer sentMessage:message transaction:transaction];
+	
+	[self _addObserver:observer selector:selector batch:NO transaction:transaction];
+	[_link performSelector:@selector(sendMessage:) withObject:message afterDelay:0.0];
+	
+	return transaction;
+}
+
+
+
+- (NSUInteger)sendMessage:(WIP7Message *)message fromObserver:(id)observer batchSelector:(SEL)selector {
+	WIP7UInt32		transaction;
+	
+	transaction = ++_transaction;
+	
+	[message setUInt32:transaction forName:@"wired.transaction"];
+	
+	[_tracer sentMessage:message transaction:transaction];
+	
+	[self _addObserver:observer selector:selector batch:YES transaction:transaction];
 	[_link performSelector:@selector(sendMessage:) withObject:message afterDelay:0.0];
 	
 	return transaction;
@@ -270,27 +456,74 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 
 
 
-- (void)link:(WCLink *)link receivedMessage:(WIP7Message *)message {
-	WIError			*error;
+- (void)link:(WCLink *)link receivedMessages:(NSArray *)messages route:(id)route {
+	_WCLinkConnectionObserver		*observer = route;
+	NSArray							*observers;
+	WIP7Message						*message;
+	NSUInteger						i, count;
 	
-	[message setContextInfo:self];
+	count = [messages count];
+	
+	if(observer && observer->batch) {
+		for(i = 0; i < count; i++)
+			[self _postNotificationForMessage:[messages objectAtIndex:i]];
+		
+		if(!observer->removed)
+			[observer->observer performSelector:observer->selector withObject:messages];
+		
+		return;
+	}
 	
-	if([[_link socket] verifyMessage:message error:&error]) {
-		if([[message name] isEqualToString:@"wired.error"])
-			[_notificationCenter postNotificationName:WCLinkConnectionReceivedErrorMessageNotification object:message];
-		else
-			[_notificationCenter postNotificationName:WCLinkConnectionReceivedMessageNotification object:message];
-
-		[_linkNotificationCenter postMessage:message];
-	} else {
-		[_notificationCenter postNotificationName:WCLinkConnectionReceivedInvalidMessageNotification
-										   object:message
-										 userInfo:[NSDictionary dictionaryWithObject:error forKey:@"WCError"]];
+	for(i = 0; i < count; i++) {
+		message = [messages objectAtIndex:i];
+		
+		[self _postNotificationForMessage:message];
+		
+		if(observer) {
+			if(!observer->removed)
+				[observer->observer performSelector:observer->selector withObject:message];
+		} else {
+			[_observersLock lock];
+			observers = [[[_nameObservers objectForKey:[message name]] copy] autorelease];
+			[_observersLock unlock];
+			
+			[self _postMessage:message toObservers:observers];
+		}
 	}
 }
 
 
 
+- (void)link:(WCLink *)link receivedInvalidMessage:(WIP7Message *)message error:(WIError *)error {
+	[message setContextInfo:self];
+	
+	[_notificationCenter mainThreadPostNotificationName:WCLinkConnectionReceivedInvalidMessageNotification
+												 object:message
+											   userInfo:[NSDictionary dictionaryWithObject:error forKey:@"WCError"]];
+}
+
+
+
+- (id)link:(WCLink *)link routeForMessage:(WIP7Message *)message {
+	id				route;
+	WIP7UInt32		transaction;
+	
+	[message setContextInfo:self];
+	
+	if(![message getUInt32:&transaction forName:@"wired.transaction"])
+		return NULL;
+	
+	[_tracer receivedMessage:message transaction:transaction];
+	
+	[_observersLock lock];
+	route = [[[_transactionObservers objectForKey:[NSNumber numberWithUnsignedInt:transaction]] retain] autorelease];
+	[_observersLock unlock];
+	
+	return route;
+}
+
+
+
 #pragma mark -
 
 - (void)connect {
@@ -348,4 +581,10 @@ NSString * const WCLinkConnectionLoggedInNotification					= @"WCLinkConnectionLo
 	return _error;
 }
 
+
+
+- (WCTransactionTracer *)transactionTracer {
+	return _tracer;
+}
+
 @end
@@ -0,0 +1,428 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <sys/event.h>
+
+#import "WCLink.h"
+#import "WCLinkReactor.h"
+#import "WCTime.h"
+
+#define WCLinkReactorLogPath					@"~/Library/Logs/Wired Client Links.log"
+#define WCLinkReactorLogInterval				600.0
+#define WCLinkReactorEvents						64
+
+
+@interface WCLinkReactor(Private)
+
+- (void)_addPendingLinks;
+- (void)_addPendingWritingLinks;
+- (void)_resumePendingLinks;
+- (void)_watchWritingLink:(WCLink *)link;
+- (void)_removeLink:(WCLink *)link error:(WIError *)error;
+- (void)_removeClosingLinks;
+
+- (void)_logIfNeeded;
+
+@end
+
+
+@implementation WCLinkReactor(Private)
+
+- (void)_addPendingLinks {
+	NSEnumerator		*enumerator;
+	NSArray				*links;
+	WCLink				*link;
+	struct kevent		event;
+	
+	[_lock lock];
+	links = [[_addedLinks copy] autorelease];
+	[_addedLinks removeAllObjects];
+	[_lock unlock];
+	
+	enumerator = [links objectEnumerator];
+	
+	while((link = [enumerator nextObject])) {
+		if([link isClosing]) {
+			[link closeWithError:NULL];
+			
+			continue;
+		}
+		
+		EV_SET(&event, [link descriptor], EVFILT_READ, EV_ADD, 0, 0, link);
+		
+		if(kevent(_queue, &event, 1, NULL, 0, NULL) < 0) {
+			[link closeWithError:[WIError errorWithDomain:NSPOSIXErrorDomain code:errno]];
+			
+			continue;
+		}
+		
+		[_links addObject:link];
+		
+		if([link hasQueuedMessages])
+			[self _watchWritingLink:link];
+	}
+}
+
+
+
+- (void)_addPendingWritingLinks {
+	NSEnumerator		*enumerator;
+	NSArray				*links;
+	WCLink				*link;
+	
+	[_lock lock];
+	links = [[_writingLinks copy] autorelease];
+	[_writingLinks removeAllObjects];
+	[_lock unlock];
+	
+	enumerator = [links objectEnumerator];
+	
+	while((link = [enumerator nextObject])) {
+		if([_links containsObject:link] && ![link isClosing] && ![link isReadingFrame])
+			[self _watchWritingLink:link];
+	}
+}
+
+
+
+- (void)_resumePendingLinks {
+	NSEnumerator		*enumerator;
+	NSArray				*links;
+	WIError				*error;
+	WCLink				*link;
+	struct kevent		event;
+	
+	[_lock lock];
+	links = [[_resumedLinks copy] autorelease];
+	[_resumedLinks removeAllObjects];
+	[_lock unlock];
+	
+	enumerator = [links objectEnumerator];
+	
+	while((link = [enumerator nextObject])) {
+		if(![_links containsObject:link])
+			continue;
+		
+		error = NULL;
+		
+		if(![link finishReadingFrameWithError:&error]) {
+			[self _removeLink:link error:error];
+			
+			continue;
+		}
+		
+		EV_SET(&event, [link descriptor], EVFILT_READ, EV_ENABLE, 0, 0, link);
+		kevent(_queue, &event, 1, NULL, 0, NULL);
+		
+		if([link hasQueuedMessages])
+			[self _watchWritingLink:link];
+	}
+}
+
+
+
+- (void)_watchWritingLink:(WCLink *)link {
+	struct kevent		event;
+	
+	EV_SET(&event, [link descriptor], EVFILT_WRITE, EV_ADD | EV_ONESHOT, NOTE_LOWAT, WCLinkWriteSpace, link);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+}
+
+
+
+- (void)_removeLink:(WCLink *)link error:(WIError *)error {
+	struct kevent		event;
+	
+	EV_SET(&event, [link descriptor], EVFILT_READ, EV_DELETE, 0, 0, NULL);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+	
+	EV_SET(&event, [link descriptor], EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+	
+	[_closedLinks addObject:link];
+	[_links removeObject:link];
+	[link closeWithError:error];
+}
+
+
+
+- (void)_removeClosingLinks {
+	NSEnumerator		*enumerator;
+	WCLink				*link;
+	
+	enumerator = [[_links allObjects] objectEnumerator];
+	
+	while((link = [enumerator nextObject])) {
+		if([link isClosing] && ![link isReadingFrame])
+			[self _removeLink:link error:NULL];
+	}
+}
+
+
+
+#pragma mark -
+
+- (void)_logIfNeeded {
+	NSEnumerator			*enumerator;
+	NSString				*path;
+	WCLink					*link;
+	WCLinkSendStatistics	statistics, totals;
+	NSTimeInterval			interval, CPUTime;
+	FILE					*fp;
+	BOOL					header;
+	
+	interval = [NSDate timeIntervalSinceReferenceDate] - _logTime;
+	
+	if(interval < WCLinkReactorLogInterval)
+		return;
+	
+	memset(&totals, 0, sizeof(totals));
+	
+	enumerator = [_links objectEnumerator];
+	
+	while((link = [enumerator nextObject])) {
+		[link getSendStatistics:&statistics];
+		
+		totals.queuedMessages		+= statistics.queuedMessages;
+		totals.writtenMessages		+= statistics.writtenMessages;
+		totals.writeLatency			+= statistics.writeLatency;
+		
+		if(statistics.peakQueuedMessages > totals.peakQueuedMessages)
+			totals.peakQueuedMessages = statistics.peakQueuedMessages;
+		
+		if(statistics.maximumWriteLatency > totals.maximumWriteLatency)
+			totals.maximumWriteLatency = statistics.maximumWriteLatency;
+	}
+	
+	CPUTime = WCThreadTime();
+	path = [WCLinkReactorLogPath stringByStandardizingPath];
+	header = ![[NSFileManager defaultManager] fileExistsAtPath:path];
+	fp = fopen([path fileSystemRepresentation], "a");
+	
+	if(fp) {
+		if(header)
+			fprintf(fp, "date\tlinks\tseconds\twakeups\twakeups/s\tCPU ms/s\tqueued\tpeak queued\twrites\twrite ms\tmax write ms\n");
+		
+		fprintf(fp, "%s\t%lu\t%.0f\t%lu\t%.3f\t%.3f\t%lu\t%lu\t%lu\t%.3f\t%.3f\n",
+			[[[NSDate date] description] UTF8String],
+			(unsigned long) [_links count],
+			interval,
+			(unsigned long) _wakeups,
+			(double) _wakeups / interval,
+			((CPUTime - _CPUTime) * 1000.0) / interval,
+			(unsigned long) totals.queuedMessages,
+			(unsigned long) totals.peakQueuedMessages,
+			(unsigned long) totals.writtenMessages,
+			totals.writtenMessages > 0 ? (totals.writeLatency * 1000.0) / totals.writtenMessages : 0.0,
+			totals.maximumWriteLatency * 1000.0);
+		fclose(fp);
+	}
+	
+	_logTime	= [NSDate timeIntervalSinceReferenceDate];
+	_CPUTime	= CPUTime;
+	_wakeups	= 0;
+}
+
+@end
+
+
+
+@implementation WCLinkReactor
+
++ (WCLinkReactor *)reactor {
+	static id	sharedReactor;
+	
+	if(!sharedReactor)
+		sharedReactor = [[self alloc] init];
+	
+	return sharedReactor;
+}
+
+
+
+- (id)init {
+	self = [super init];
+	
+	_queue			= kqueue();
+	
+	if(_queue < 0 || pipe(_pipe) < 0) {
+		NSLog(@"*** %@: could not create event queue: %s", self, strerror(errno));
+		
+		[self release];
+		
+		return NULL;
+	}
+	
+	fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL) | O_NONBLOCK);
+	
+	_links			= [[NSMutableSet alloc] init];
+	_addedLinks		= [[NSMutableArray alloc] init];
+	_writingLinks	= [[NSMutableArray alloc] init];
+	_closedLinks	= [[NSMutableArray alloc] init];
+	_resumedLinks	= [[NSMutableArray alloc] init];
+	_lock			= [[NSLock alloc] init];
+	_logTime		= [NSDate timeIntervalSinceReferenceDate];
+	
+	[WIThread detachNewThreadSelector:@selector(reactorThread:) toTarget:self withObject:NULL];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[_links release];
+	[_addedLinks release];
+	[_writingLinks release];
+	[_closedLinks release];
+	[_resumedLinks release];
+	[_lock release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)addLink:(WCLink *)link {
+	[_lock lock];
+	[_addedLinks addObject:link];
+	[_lock unlock];
+	
+	[self wakeUp];
+}
+
+
+
+- (void)addWritingLink:(WCLink *)link {
+	[_lock lock];
+	[_writingLinks addObject:link];
+	[_lock unlock];
+	
+	[self wakeUp];
+}
+
+
+
+- (void)resumeReadingLink:(WCLink *)link {
+	[_lock lock];
+	[_resumedLinks addObject:link];
+	[_lock unlock];
+	
+	[self wakeUp];
+}
+
+
+
+- (void)wakeUp {
+	char	c = 0;
+	
+	write(_pipe[1], &c, 1);
+}
+
+
+
+#pragma mark -
+
+- (void)reactorThread:(id)arg {
+	NSAutoreleasePool	*pool;
+	WIError				*error;
+	WCLink				*link;
+	struct kevent		event, events[WCLinkReactorEvents];
+	char				buffer[64];
+	int					i, count;
+	
+	pool = [[NSAutoreleasePool alloc] init];
+	
+	EV_SET(&event, _pipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+	
+	_CPUTime = WCThreadTime();
+	
+	while(YES) {
+		count = kevent(_queue, NULL, 0, events, WCLinkReactorEvents, NULL);
+		
+		if(count < 0) {
+			if(errno == EINTR)
+				continue;
+			
+			NSLog(@"*** %@: kevent(): %s", self, strerror(errno));
+			
+			break;
+		}
+		
+		_wakeups++;
+		
+		for(i = 0; i < count; i++) {
+			if((int) events[i].ident == _pipe[0]) {
+				while(read(_pipe[0], buffer, sizeof(buffer)) > 0)
+					;
+				
+				continue;
+			}
+			
+			link = events[i].udata;
+			
+			if(![_links containsObject:link] || [link isClosing])
+				continue;
+			
+			error = NULL;
+			
+			if(events[i].filter == EVFILT_WRITE) {
+				if(![link writeMessagesWithError:&error])
+					[self _removeLink:link error:error];
+				else if([link hasQueuedMessages] && ![link isReadingFrame])
+					[self _watchWritingLink:link];
+			} else {
+				if(![link readMessagesAtEndOfFile:((events[i].flags & EV_EOF) != 0) error:&error]) {
+					[self _removeLink:link error:error];
+				}
+				else if([link isReadingFrame]) {
+					EV_SET(&event, [link descriptor], EVFILT_READ, EV_DISABLE, 0, 0, link);
+					kevent(_queue, &event, 1, NULL, 0, NULL);
+				}
+			}
+		}
+		
+		[_closedLinks removeAllObjects];
+		
+		[self _addPendingLinks];
+		[self _addPendingWritingLinks];
+		[self _resumePendingLinks];
+		[self _removeClosingLinks];
+		[self _logIfNeeded];
+		
+		[pool release];
+		pool = [[NSAutoreleasePool alloc] init];
+	}
+	
+	[pool release];
+}
+
+@end
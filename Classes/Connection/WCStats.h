@@ -33,6 +33,24 @@ extern NSString * const WCStatsOnline;
 extern NSString * const WCStatsMessagesSent;
 extern NSString * const WCStatsMessagesReceived;
 
+extern NSString * const WCStatsSampleDate;
+extern NSString * const WCStatsSampleBytes;
+extern NSString * const WCStatsSampleStallTime;
+extern NSString * const WCStatsSampleReconnects;
+extern NSString * const WCStatsSampleHandshakeTime;
+
+
+struct _WCStatsSummary {
+	WIFileOffset						bytes;
+	double								averageSpeed;
+	double								peakSpeed;
+	NSTimeInterval						stallTime;
+	NSUInteger							reconnects;
+	NSUInteger							handshakes;
+	NSTimeInterval						handshakeTime;
+};
+typedef struct _WCStatsSummary			WCStatsSummary;
+
 
 @interface WCStats : WIObject {
 	NSMutableDictionary					*_stats;
@@ -40,6 +58,9 @@ extern NSString * const WCStatsMessagesReceived;
 	NSRecursiveLock						*_lock;
 	NSUInteger							_connections;
 	
+	NSMutableDictionary					*_serverSeries;
+	NSMutableDictionary					*_transferSeries;
+	
 	WISizeFormatter						*_sizeFormatter;
 	WITimeIntervalFormatter				*_timeIntervalFormatter;
 	
@@ -55,6 +76,16 @@ extern NSString * const WCStatsMessagesReceived;
 - (void)addUnsignedInt:(unsigned int)number forKey:(id)key;
 - (void)addUnsignedLongLong:(unsigned long long)number forKey:(id)key;
 
+- (void)addTransferredBytes:(WIFileOffset)bytes stallTime:(NSTimeInterval)stallTime forTransfer:(NSString *)transfer server:(NSString *)server;
+- (void)addReconnectForTransfer:(NSString *)transfer server:(NSString *)server;
+- (void)addHandshakeTime:(NSTimeInterval)handshakeTime forServer:(NSString *)server;
+- (void)removeSeriesForTransfer:(NSString *)transfer;
+- (NSArray *)servers;
+- (WCStatsSummary)summaryForServer:(NSString *)server interval:(NSTimeInterval)interval;
+- (WCStatsSummary)summaryForTransfer:(NSString *)transfer interval:(NSTimeInterval)interval;
+- (NSArray *)samplesForServer:(NSString *)server interval:(NSTimeInterval)interval;
+- (NSArray *)samplesForTransfer:(NSString *)transfer interval:(NSTimeInterval)interval;
+
 - (NSString *)stringValue;
 
 @end
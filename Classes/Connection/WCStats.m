@@ -28,8 +28,11 @@
 
 #import "WCServerConnection.h"
 #import "WCStats.h"
+#import "WCStatsSeries.h"
 
 #define WCStatsPath								@"~/Library/Application Support/Wired Client/Stats.plist"
+#define WCStatsServerSeriesCapacity				86400
+#define WCStatsTransferSeriesCapacity			3600
 
 
 NSString * const WCStatsDownloaded				= @"Downloaded";
@@ -39,6 +42,12 @@ NSString * const WCStatsOnline					= @"Online";
 NSString * const WCStatsMessagesSent			= @"Messages Sent";
 NSString * const WCStatsMessagesReceived		= @"Messages Received";
 
+NSString * const WCStatsSampleDate				= @"Date";
+NSString * const WCStatsSampleBytes				= @"Bytes";
+NSString * const WCStatsSampleStallTime			= @"Stall Time";
+NSString * const WCStatsSampleReconnects		= @"Reconnects";
+NSString * const WCStatsSampleHandshakeTime		= @"Handshake Time";
+
 
 static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef, EventRef, void *);
 
@@ -54,6 +63,10 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef, EventRef
 
 - (void)_saveStats;
 
+- (void)_addBytes:(WIFileOffset)bytes stallTime:(NSTimeInterval)stallTime reconnects:(NSUInteger)reconnects forTransfer:(NSString *)transfer server:(NSString *)server;
+- (WCStatsSeries *)_seriesForServer:(NSString *)server;
+- (void)_removeStaleSeries;
+
 @end
 
 
@@ -147,6 +160,80 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef nextHandl
 	[_lock unlock];
 }
 
+
+
+#pragma mark -
+
+- (void)_addBytes:(WIFileOffset)bytes stallTime:(NSTimeInterval)stallTime reconnects:(NSUInteger)reconnects forTransfer:(NSString *)transfer server:(NSString *)server {
+	WCStatsSeries		*series;
+	NSTimeInterval		time;
+	
+	time = [NSDate timeIntervalSinceReferenceDate];
+	
+	[_lock lock];
+	
+	if(server)
+		[[self _seriesForServer:server] addBytes:bytes stallTime:stallTime reconnects:reconnects atTime:time];
+	
+	if(transfer) {
+		series = [_transferSeries objectForKey:transfer];
+		
+		if(!series) {
+			series = [[WCStatsSeries alloc] initWithCapacity:WCStatsTransferSeriesCapacity];
+			[_transferSeries setObject:series forKey:transfer];
+			[series release];
+		}
+		
+		[series addBytes:bytes stallTime:stallTime reconnects:reconnects atTime:time];
+	}
+	
+	[_lock unlock];
+}
+
+
+
+- (WCStatsSeries *)_seriesForServer:(NSString *)server {
+	WCStatsSeries		*series;
+	
+	series = [_serverSeries objectForKey:server];
+	
+	if(!series) {
+		series = [[WCStatsSeries alloc] initWithCapacity:WCStatsServerSeriesCapacity];
+		[_serverSeries setObject:series forKey:server];
+		[series release];
+	}
+	
+	return series;
+}
+
+
+
+- (void)_removeStaleSeries {
+	NSEnumerator		*enumerator;
+	NSString			*key;
+	NSTimeInterval		time;
+	
+	time = [NSDate timeIntervalSinceReferenceDate];
+	
+	[_lock lock];
+	
+	enumerator = [[_serverSeries allKeys] objectEnumerator];
+	
+	while((key = [enumerator nextObject])) {
+		if(time - [[_serverSeries objectForKey:key] lastTime] > WCStatsServerSeriesCapacity)
+			[_serverSeries removeObjectForKey:key];
+	}
+	
+	enumerator = [[_transferSeries allKeys] objectEnumerator];
+	
+	while((key = [enumerator nextObject])) {
+		if(time - [[_transferSeries objectForKey:key] lastTime] > WCStatsTransferSeriesCapacity)
+			[_transferSeries removeObjectForKey:key];
+	}
+	
+	[_lock unlock];
+}
+
 @end
 
 
@@ -185,6 +272,9 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef nextHandl
 	if([[_stats objectForKey:WCStatsOnline] doubleValue] > 864000000.0)
 		[_stats setObject:[NSNumber numberWithInt:0] forKey:WCStatsOnline];
 	
+	_serverSeries = [[NSMutableDictionary alloc] init];
+	_transferSeries = [[NSMutableDictionary alloc] init];
+	
 	_sizeFormatter = [[WISizeFormatter alloc] init];
 	
 	_timeIntervalFormatter = [[WITimeIntervalFormatter alloc] init];
@@ -232,6 +322,8 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef nextHandl
 	[_lock release];
 	[_stats release];
 	[_date release];
+	[_serverSeries release];
+	[_transferSeries release];
 	
 	[_sizeFormatter release];
 	[_timeIntervalFormatter release];
@@ -293,6 +385,7 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef nextHandl
 
 - (void)saveTimer:(NSTimer *)timer {
 	[self _saveStats];
+	[self _removeStaleSeries];
 }
 
 
@@ -341,6 +434,115 @@ static OSStatus _WCStatsEventSystemTimeDateChanged(EventHandlerCallRef nextHandl
 
 
 
+#pragma mark -
+
+- (void)addTransferredBytes:(WIFileOffset)bytes stallTime:(NSTimeInterval)stallTime forTransfer:(NSString *)transfer server:(NSString *)server {
+	[self _addBytes:bytes stallTime:stallTime reconnects:0 forTransfer:transfer server:server];
+}
+
+
+
+- (void)addReconnectForTransfer:(NSString *)transfer server:(NSString *)server {
+	[self _addBytes:0 stallTime:0.0 reconnects:1 forTransfer:transfer server:server];
+}
+
+
+
+- (void)addHandshakeTime:(NSTimeInterval)handshakeTime forServer:(NSString *)server {
+	if(!server)
+		return;
+	
+	[_lock lock];
+	[[self _seriesForServer:server] addHandshakeTime:handshakeTime atTime:[NSDate timeIntervalSinceReferenceDate]];
+	[_lock unlock];
+}
+
+
+
+- (void)removeSeriesForTransfer:(NSString *)transfer {
+	[_lock lock];
+	[_transferSeries removeObjectForKey:transfer];
+	[_lock unlock];
+}
+
+
+
+- (NSArray *)servers {
+	NSArray			*servers;
+	
+	[_lock lock];
+	servers = [[_serverSeries allKeys] sortedArrayUsingSelector:@selector(compare:)];
+	[_lock unlock];
+	
+	return servers;
+}
+
+
+
+- (WCStatsSummary)summaryForServer:(NSString *)server interval:(NSTimeInterval)interval {
+	WCStatsSeries		*series;
+	WCStatsSummary		summary;
+	
+	[_lock lock];
+	
+	series = [_serverSeries objectForKey:server];
+	
+	if(series)
+		summary = [series summarySinceTime:floor([NSDate timeIntervalSinceReferenceDate] - interval)];
+	else
+		memset(&summary, 0, sizeof(summary));
+	
+	[_lock unlock];
+	
+	return summary;
+}
+
+
+
+- (WCStatsSummary)summaryForTransfer:(NSString *)transfer interval:(NSTimeInterval)interval {
+	WCStatsSeries		*series;
+	WCStatsSummary		summary;
+	
+	[_lock lock];
+	
+	series = [_transferSeries objectForKey:transfer];
+	
+	if(series)
+		summary = [series summarySinceTime:floor([NSDate timeIntervalSinceReferenceDate] - interval)];
+	else
+		memset(&summary, 0, sizeof(summary));
+	
+	[_lock unlock];
+	
+	return summary;
+}
+
+
+
+- (NSArray *)samplesForServer:(NSString *)server interval:(NSTimeInterval)interval {
+	NSArray			*samples;
+	
+	[_lock lock];
+	samples = [[_serverSeries objectForKey:server] samplesSinceTime:floor([NSDate timeIntervalSinceReferenceDate] - interval)];
+	[_lock unlock];
+	
+	return samples ? samples : [NSArray array];
+}
+
+
+
+- (NSArray *)samplesForTransfer:(NSString *)transfer interval:(NSTimeInterval)interval {
+	NSArray			*samples;
+	
+	[_lock lock];
+	samples = [[_transferSeries objectForKey:transfer] samplesSinceTime:floor([NSDate timeIntervalSinceReferenceDate] - interval)];
+	[_lock unlock];
+	
+	return samples ? samples : [NSArray array];
+}
+
+
+
 #pragma mark -
 
 - (NSString *)stringValue {
@@ -0,0 +1,198 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#import "WCStats.h"
+#import "WCStatsSeries.h"
+
+struct _WCStatsSeriesSample {
+	NSTimeInterval						time;
+	WIFileOffset						bytes;
+	NSTimeInterval						stallTime;
+	NSUInteger							reconnects;
+	NSUInteger							handshakes;
+	NSTimeInterval						handshakeTime;
+};
+
+
+@interface WCStatsSeries(Private)
+
+- (struct _WCStatsSeriesSample *)_sampleAtTime:(NSTimeInterval)time;
+
+@end
+
+
+@implementation WCStatsSeries(Private)
+
+- (struct _WCStatsSeriesSample *)_sampleAtTime:(NSTimeInterval)time {
+	struct _WCStatsSeriesSample		*sample;
+	
+	time = floor(time);
+	
+	if(_count > 0 && _samples[_index].time == time)
+		return &_samples[_index];
+	
+	if(_count > 0)
+		_index = (_index + 1) % _capacity;
+	
+	if(_count < _capacity)
+		_count++;
+	
+	sample = &_samples[_index];
+	
+	memset(sample, 0, sizeof(struct _WCStatsSeriesSample));
+	
+	sample->time = time;
+	
+	return sample;
+}
+
+@end
+
+
+
+@implementation WCStatsSeries
+
+- (id)initWithCapacity:(NSUInteger)capacity {
+	self = [super init];
+	
+	_capacity	= capacity;
+	_samples	= calloc(_capacity, sizeof(struct _WCStatsSeriesSample));
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	free(_samples);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)addBytes:(WIFileOffset)bytes stallTime:(NSTimeInterval)stallTime reconnects:(NSUInteger)reconnects atTime:(NSTimeInterval)time {
+	struct _WCStatsSeriesSample		*sample;
+	
+	sample = [self _sampleAtTime:time];
+	
+	sample->bytes		+= bytes;
+	sample->stallTime	+= stallTime;
+	sample->reconnects	+= reconnects;
+}
+
+
+
+- (void)addHandshakeTime:(NSTimeInterval)handshakeTime atTime:(NSTimeInterval)time {
+	struct _WCStatsSeriesSample		*sample;
+	
+	sample = [self _sampleAtTime:time];
+	
+	sample->handshakes++;
+	sample->handshakeTime += handshakeTime;
+}
+
+
+
+#pragma mark -
+
+- (NSTimeInterval)lastTime {
+	return (_count > 0) ? _samples[_index].time : 0.0;
+}
+
+
+
+- (WCStatsSummary)summarySinceTime:(NSTimeInterval)time {
+	struct _WCStatsSeriesSample		*sample;
+	WCStatsSummary					summary;
+	NSTimeInterval					first;
+	NSUInteger						i;
+	
+	memset(&summary, 0, sizeof(summary));
+	
+	first = 0.0;
+	
+	for(i = 0; i < _count; i++) {
+		sample = &_samples[(_index + _capacity - i) % _capacity];
+		
+		if(sample->time < time)
+			break;
+		
+		summary.bytes			+= sample->bytes;
+		summary.stallTime		+= sample->stallTime;
+		summary.reconnects		+= sample->reconnects;
+		summary.handshakes		+= sample->handshakes;
+		summary.handshakeTime	+= sample->handshakeTime;
+		
+		if((double) sample->bytes > summary.peakSpeed)
+			summary.peakSpeed = sample->bytes;
+		
+		first = sample->time;
+	}
+	
+	if(summary.bytes > 0)
+		summary.averageSpeed = summary.bytes / (_samples[_index].time - first + 1.0);
+	
+	return summary;
+}
+
+
+
+- (NSArray *)samplesSinceTime:(NSTimeInterval)time {
+	NSMutableArray					*samples;
+	struct _WCStatsSeriesSample		*sample;
+	NSUInteger						i;
+	
+	samples = [NSMutableArray array];
+	
+	for(i = 0; i < _count; i++) {
+		sample = &_samples[(_index + _capacity - i) % _capacity];
+		
+		if(sample->time < time)
+			break;
+		
+		[samples insertObject:[NSDictionary dictionaryWithObjectsAndKeys:
+			[NSDate dateWithTimeIntervalSinceReferenceDate:sample->time],
+				WCStatsSampleDate,
+			[NSNumber numberWithUnsignedLongLong:sample->bytes],
+				WCStatsSampleBytes,
+			[NSNumber numberWithDouble:sample->stallTime],
+				WCStatsSampleStallTime,
+			[NSNumber numberWithUnsignedInteger:sample->reconnects],
+				WCStatsSampleReconnects,
+			[NSNumber numberWithDouble:(sample->handshakes > 0) ? sample->handshakeTime / sample->handshakes : 0.0],
+				WCStatsSampleHandshakeTime,
+			NULL]
+					  atIndex:0];
+	}
+	
+	return samples;
+}
+
+@end
@@ -0,0 +1,436 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#import "WCTransactionTracer.h"
+
+#define WCTransactionTracerStaleInterval			600.0
+#define WCTransactionTracerPruneInterval			60.0
+#define WCTransactionTracerMaximumTransactions		1000
+
+
+struct _WCTransactionTrace {
+	NSString									*name;
+	NSTimeInterval								sendTime;
+	NSTimeInterval								firstReplyTime;
+	NSUInteger									replies;
+};
+typedef struct _WCTransactionTrace				_WCTransactionTrace;
+
+struct _WCTransactionTracerStats {
+	NSUInteger									requests;
+	NSUInteger									errors;
+	NSUInteger									replies;
+	NSTimeInterval								latency;
+	NSTimeInterval								maximumLatency;
+	NSTimeInterval								firstReplyTime;
+	NSTimeInterval								streamTime;
+	NSUInteger									histogram[WCTransactionTracerBuckets];
+};
+typedef struct _WCTransactionTracerStats		_WCTransactionTracerStats;
+
+
+static const double _WCTransactionTracerBucketLimits[WCTransactionTracerBuckets - 1] = {
+	1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0, 2000.0
+};
+
+static NSString * const _WCTransactionTracerFinalReplies[][2] = {
+	{ @"wired.client_info",				@"wired.server_info" },
+	{ @"wired.send_ping",				@"wired.ping" },
+	{ @"wired.send_login",				@"wired.account.privileges" },
+	{ @"wired.user.get_info",			@"wired.user.info" },
+	{ @"wired.chat.create_chat",		@"wired.chat.chat_created" },
+	{ @"wired.board.get_board_info",	@"wired.board.board_info" },
+	{ @"wired.file.get_info",			@"wired.file.info" },
+	{ @"wired.file.preview_file",		@"wired.file.preview" },
+	{ @"wired.account.read_user",		@"wired.account.user" },
+	{ @"wired.account.read_group",		@"wired.account.group" },
+	{ @"wired.transfer.download_file",	@"wired.transfer.download" },
+	{ @"wired.transfer.upload_file",	@"wired.transfer.upload_ready" },
+	{ @"wired.event.get_first_time",	@"wired.event.first_time" },
+	{ @"wired.settings.get_settings",	@"wired.settings.settings" },
+	{ @"wired.tracker.get_categories",	@"wired.tracker.categories" }
+};
+
+static BOOL _WCTransactionTracerIsFinalReply(NSString *, NSString *);
+static void _WCTransactionTracerFreeTrace(const void *, const void *, void *);
+static NSInteger _WCTransactionTracerCompareLatency(id, id, void *);
+static NSString * _WCTransactionTracerJSONString(NSString *);
+
+static BOOL _WCTransactionTracerIsFinalReply(NSString *request, NSString *reply) {
+	NSUInteger		i;
+	
+	if([reply isEqualToString:@"wired.okay"] || [reply isEqualToString:@"wired.error"] ||
+	   [reply isEqualToString:@"wired.banned"] || [reply hasSuffix:@".done"])
+		return YES;
+	
+	for(i = 0; i < sizeof(_WCTransactionTracerFinalReplies) / sizeof(*_WCTransactionTracerFinalReplies); i++) {
+		if([request isEqualToString:_WCTransactionTracerFinalReplies[i][0]])
+			return [reply isEqualToString:_WCTransactionTracerFinalReplies[i][1]];
+	}
+	
+	return NO;
+}
+
+
+
+static void _WCTransactionTracerFreeTrace(const void *key, const void *value, void *context) {
+	_WCTransactionTrace		*trace = (_WCTransactionTrace *) value;
+	
+	[trace->name release];
+	free(trace);
+}
+
+
+
+static NSInteger _WCTransactionTracerCompareLatency(id object1, id object2, void *context) {
+	NSDictionary					*names = context;
+	const _WCTransactionTracerStats	*stats1 = [[names objectForKey:object1] bytes];
+	const _WCTransactionTracerStats	*stats2 = [[names objectForKey:object2] bytes];
+	
+	if(stats1->latency > stats2->latency)
+		return -1;
+	else if(stats1->latency < stats2->latency)
+		return 1;
+	
+	return [(NSString *) object1 compare:object2];
+}
+
+
+
+static NSString * _WCTransactionTracerJSONString(NSString *string) {
+	NSMutableString		*json;
+	
+	json = [[string mutableCopy] autorelease];
+	
+	[json replaceOccurrencesOfString:@"\\" withString:@"\\\\" options:0 range:NSMakeRange(0, [json length])];
+	[json replaceOccurrencesOfString:@"\"" withString:@"\\\"" options:0 range:NSMakeRange(0, [json length])];
+	
+	return [NSSWF:@"\"%@\"", json];
+}
+
+
+
+@interface WCTransactionTracer(Private)
+
+- (void)_finishTransaction:(NSUInteger)transaction trace:(_WCTransactionTrace *)trace error:(BOOL)error time:(NSTimeInterval)time;
+- (void)_removeStaleTransactionsBeforeTime:(NSTimeInterval)time;
+
+- (NSArray *)_sortedNames;
+
+@end
+
+
+@implementation WCTransactionTracer(Private)
+
+- (void)_finishTransaction:(NSUInteger)transaction trace:(_WCTransactionTrace *)trace error:(BOOL)error time:(NSTimeInterval)time {
+	NSMutableData					*data;
+	_WCTransactionTracerStats		*stats;
+	NSTimeInterval					latency;
+	NSUInteger						i;
+	
+	data = [_names objectForKey:trace->name];
+	
+	if(!data) {
+		data = [NSMutableData dataWithLength:sizeof(_WCTransactionTracerStats)];
+		
+		[_names setObject:data forKey:trace->name];
+	}
+	
+	stats	= [data mutableBytes];
+	latency	= time - trace->sendTime;
+	
+	stats->requests++;
+	stats->replies			+= trace->replies;
+	stats->latency			+= latency;
+	stats->firstReplyTime	+= trace->firstReplyTime - trace->sendTime;
+	stats->streamTime		+= time - trace->firstReplyTime;
+	
+	if(error)
+		stats->errors++;
+	
+	if(latency > stats->maximumLatency)
+		stats->maximumLatency = latency;
+	
+	for(i = 0; i < WCTransactionTracerBuckets - 1; i++) {
+		if(latency * 1000.0 <= _WCTransactionTracerBucketLimits[i])
+			break;
+	}
+	
+	stats->histogram[i]++;
+	
+	CFDictionaryRemoveValue(_transactions, (const void *) transaction);
+	
+	_WCTransactionTracerFreeTrace((const void *) transaction, trace, NULL);
+}
+
+
+
+- (void)_removeStaleTransactionsBeforeTime:(NSTimeInterval)time {
+	_WCTransactionTrace		**traces;
+	const void				**keys;
+	CFIndex					i, count;
+	
+	count	= CFDictionaryGetCount(_transactions);
+	keys	= malloc(count * sizeof(*keys));
+	traces	= malloc(count * sizeof(*traces));
+	
+	CFDictionaryGetKeysAndValues(_transactions, keys, (const void **) traces);
+	
+	for(i = 0; i < count; i++) {
+		if(traces[i]->sendTime < time) {
+			CFDictionaryRemoveValue(_transactions, keys[i]);
+			
+			_WCTransactionTracerFreeTrace(keys[i], traces[i], NULL);
+		}
+	}
+	
+	free(keys);
+	free(traces);
+}
+
+
+
+#pragma mark -
+
+- (NSArray *)_sortedNames {
+	return [[_names allKeys] sortedArrayUsingFunction:_WCTransactionTracerCompareLatency context:_names];
+}
+
+@end
+
+
+
+@implementation WCTransactionTracer
+
+- (id)init {
+	self = [super init];
+	
+	_transactions	= CFDictionaryCreateMutable(NULL, 0, NULL, NULL);
+	_names			= [[NSMutableDictionary alloc] init];
+	_date			= [[NSDate date] retain];
+	_lock			= [[NSLock alloc] init];
+	_pruneTime		= [NSDate timeIntervalSinceReferenceDate];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	CFDictionaryApplyFunction(_transactions, _WCTransactionTracerFreeTrace, NULL);
+	CFRelease(_transactions);
+	
+	[_names release];
+	[_date release];
+	[_lock release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)sentMessage:(WIP7Message *)message transaction:(NSUInteger)transaction {
+	_WCTransactionTrace		*trace, *oldTrace;
+	NSTimeInterval			time;
+	
+	time = [NSDate timeIntervalSinceReferenceDate];
+	trace = malloc(sizeof(_WCTransactionTrace));
+	trace->name				= [[message name] copy];
+	trace->sendTime			= time;
+	trace->firstReplyTime	= 0.0;
+	trace->replies			= 0;
+	
+	[_lock lock];
+	
+	if(time - _pruneTime >= WCTransactionTracerPruneInterval ||
+	   CFDictionaryGetCount(_transactions) >= WCTransactionTracerMaximumTransactions) {
+		[self _removeStaleTransactionsBeforeTime:time - WCTransactionTracerStaleInterval];
+		
+		_pruneTime = time;
+	}
+	
+	oldTrace = (_WCTransactionTrace *) CFDictionaryGetValue(_transactions, (const void *) transaction);
+	
+	if(oldTrace)
+		_WCTransactionTracerFreeTrace((const void *) transaction, oldTrace, NULL);
+	
+	CFDictionarySetValue(_transactions, (const void *) transaction, trace);
+	
+	[_lock unlock];
+}
+
+
+
+- (void)receivedMessage:(WIP7Message *)message transaction:(NSUInteger)transaction {
+	_WCTransactionTrace		*trace;
+	NSString				*name;
+	NSTimeInterval			time;
+	
+	time = [NSDate timeIntervalSinceReferenceDate];
+	
+	[_lock lock];
+	
+	trace = (_WCTransactionTrace *) CFDictionaryGetValue(_transactions, (const void *) transaction);
+	
+	if(trace) {
+		name = [message name];
+		
+		if(trace->replies == 0)
+			trace->firstReplyTime = time;
+		
+		trace->replies++;
+		
+		if(_WCTransactionTracerIsFinalReply(trace->name, name))
+			[self _finishTransaction:transaction trace:trace error:[name isEqualToString:@"wired.error"] time:time];
+	}
+	
+	[_lock unlock];
+}
+
+
+
+#pragma mark -
+
+- (void)reset {
+	[_lock lock];
+	
+	[_names removeAllObjects];
+	
+	[_date release];
+	_date = [[NSDate date] retain];
+	
+	[_lock unlock];
+}
+
+
+
+- (NSString *)summary {
+	NSEnumerator						*enumerator;
+	NSMutableString						*string;
+	NSString							*name;
+	const _WCTransactionTracerStats		*stats;
+	NSUInteger							i;
+	
+	[_lock lock];
+	
+	string = [NSMutableString stringWithFormat:NSLS(@"Request latencies since %@:", @"Transaction trace summary (date)"), _date];
+	
+	if([_names count] == 0)
+		[string appendString:NSLS(@"\nNo requests have completed", @"Transaction trace summary")];
+	
+	enumerator = [[self _sortedNames] objectEnumerator];
+	
+	while((name = [enumerator nextObject])) {
+		stats = [[_names objectForKey:name] bytes];
+		
+		[string appendFormat:NSLS(@"\n%@: %lu requests, %lu errors, %.1f ms average, %.1f ms maximum, %.1f ms to first reply, %lu replies, %.0f replies/s",
+								  @"Transaction trace summary (name, requests, errors, average latency, maximum latency, first reply latency, replies, replies per second)"),
+			name,
+			(unsigned long) stats->requests,
+			(unsigned long) stats->errors,
+			(stats->latency * 1000.0) / stats->requests,
+			stats->maximumLatency * 1000.0,
+			(stats->firstReplyTime * 1000.0) / stats->requests,
+			(unsigned long) stats->replies,
+			stats->streamTime > 0.0 ? stats->replies / stats->streamTime : 0.0];
+		
+		[string appendString:@"\n   "];
+		
+		for(i = 0; i < WCTransactionTracerBuckets; i++) {
+			if(stats->histogram[i] == 0)
+				continue;
+			
+			if(i < WCTransactionTracerBuckets - 1)
+				[string appendFormat:@" \u2264%.0f ms: %lu", _WCTransactionTracerBucketLimits[i], (unsigned long) stats->histogram[i]];
+			else
+				[string appendFormat:@" >%.0f ms: %lu", _WCTransactionTracerBucketLimits[i - 1], (unsigned long) stats->histogram[i]];
+		}
+	}
+	
+	[_lock unlock];
+	
+	return string;
+}
+
+
+
+- (NSString *)JSONRepresentation {
+	NSEnumerator						*enumerator;
+	NSMutableString						*string;
+	NSString							*name;
+	const _WCTransactionTracerStats		*stats;
+	NSUInteger							i;
+	BOOL								first = YES;
+	
+	[_lock lock];
+	
+	string = [NSMutableString stringWithFormat:@"{\n\t\"since\": %@,\n\t\"requests\": [",
+		_WCTransactionTracerJSONString([_date description])];
+	
+	enumerator = [[self _sortedNames] objectEnumerator];
+	
+	while((name = [enumerator nextObject])) {
+		stats = [[_names objectForKey:name] bytes];
+		
+		[string appendFormat:@"%@\n\t\t{\n\t\t\t\"name\": %@,\n\t\t\t\"requests\": %lu,\n\t\t\t\"errors\": %lu,\n\t\t\t\"replies\": %lu,\n"
+							 @"\t\t\t\"average_latency_ms\": %.3f,\n\t\t\t\"maximum_latency_ms\": %.3f,\n"
+							 @"\t\t\t\"average_first_reply_ms\": %.3f,\n\t\t\t\"replies_per_second\": %.3f,\n\t\t\t\"histogram\": [",
+			first ? @"" : @",",
+			_WCTransactionTracerJSONString(name),
+			(unsigned long) stats->requests,
+			(unsigned long) stats->errors,
+			(unsigned long) stats->replies,
+			(stats->latency * 1000.0) / stats->requests,
+			stats->maximumLatency * 1000.0,
+			(stats->firstReplyTime * 1000.0) / stats->requests,
+			stats->streamTime > 0.0 ? stats->replies / stats->streamTime : 0.0];
+		
+		for(i = 0; i < WCTransactionTracerBuckets; i++) {
+			if(i < WCTransactionTracerBuckets - 1) {
+				[string appendFormat:@"%@\n\t\t\t\t{ \"maximum_ms\": %.0f, \"count\": %lu }",
+					i == 0 ? @"" : @",", _WCTransactionTracerBucketLimits[i], (unsigned long) stats->histogram[i]];
+			} else {
+				[string appendFormat:@",\n\t\t\t\t{ \"maximum_ms\": null, \"count\": %lu }",
+					(unsigned long) stats->histogram[i]];
+			}
+		}
+		
+		[string appendString:@"\n\t\t\t]\n\t\t}"];
+		
+		first = NO;
+	}
+	
+	[string appendString:@"\n\t]\n}\n"];
+	
+	[_lock unlock];
+	
+	return string;
+}
+
+@end
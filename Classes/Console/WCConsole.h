@@ -37,4 +37,8 @@
 
 - (void)log:(NSString *)format, ...;
 
+- (IBAction)showRequestLatencies:(id)sender;
+- (IBAction)exportRequestLatencies:(id)sender;
+- (IBAction)resetRequestLatencies:(id)sender;
+
 @end
@@ -29,6 +29,7 @@
 #import "WCApplicationController.h"
 #import "WCConsole.h"
 #import "WCServerConnection.h"
+#import "WCTransactionTracer.h"
 
 #define WCConsoleMaxLength						1048576
 
@@ -135,6 +136,25 @@
 
 
 
+#pragma mark -
+
+- (NSMenu *)textView:(NSTextView *)textView menu:(NSMenu *)menu forEvent:(NSEvent *)event atIndex:(NSUInteger)index {
+	[menu addItem:[NSMenuItem separatorItem]];
+	[[menu addItemWithTitle:NSLS(@"Show Request Latencies", @"Console menu item")
+					 action:@selector(showRequestLatencies:)
+			  keyEquivalent:@""] setTarget:self];
+	[[menu addItemWithTitle:NSLS(@"Export Request Latencies\u2026", @"Console menu item")
+					 action:@selector(exportRequestLatencies:)
+			  keyEquivalent:@""] setTarget:self];
+	[[menu addItemWithTitle:NSLS(@"Reset Request Latencies", @"Console menu item")
+					 action:@selector(resetRequestLatencies:)
+			  keyEquivalent:@""] setTarget:self];
+	
+	return menu;
+}
+
+
+
 #pragma mark -
 
 - (void)linkConnectionReceivedMessage:(NSNotification *)notification {
@@ -186,4 +206,52 @@
 	va_end(ap);
 }
 
+
+
+#pragma mark -
+
+- (IBAction)showRequestLatencies:(id)sender {
+	[self _log:[[[self connection] transactionTracer] summary] color:[NSColor blackColor]];
+	
+	[self showWindow:self];
+}
+
+
+
+- (IBAction)exportRequestLatencies:(id)sender {
+	NSSavePanel				*savePanel;
+	
+	savePanel = [NSSavePanel savePanel];
+	[savePanel setRequiredFileType:@"json"];
+	[savePanel setCanSelectHiddenExtension:YES];
+	[savePanel beginSheetForDirectory:NULL
+								 file:[[NSSWF:NSLS(@"%@ Requests", @"Default export request latencies name (server)"), [[self connection] name]]
+										stringByAppendingPathExtension:@"json"]
+					   modalForWindow:[self window]
+						modalDelegate:self
+					   didEndSelector:@selector(exportRequestLatenciesPanelDidEnd:returnCode:contextInfo:)
+						  contextInfo:NULL];
+}
+
+
+
+- (void)exportRequestLatenciesPanelDidEnd:(NSSavePanel *)savePanel returnCode:(NSInteger)returnCode contextInfo:(void *)contextInfo {
+	NSError			*error;
+	
+	if(returnCode == NSOKButton) {
+		if(![[[[self connection] transactionTracer] JSONRepresentation] writeToURL:[savePanel URL]
+																	  atomically:YES
+																		encoding:NSUTF8StringEncoding
+																		   error:&error]) {
+			[self _log:[error localizedDescription] color:[NSColor redColor]];
+		}
+	}
+}
+
+
+
+- (IBAction)resetRequestLatencies:(id)sender {
+	[[[self connection] transactionTracer] reset];
+}
+
 @end
@@ -37,6 +37,7 @@ enum _WCWiredClientError {
 	WCWiredClientTransferExists,
 	WCWiredClientTransferFailed,
 	WCWiredClientUserNotFound,
+	WCWiredClientTransferFileChanged,
 };
 typedef enum _WCWiredClientError				WCWiredClientError;
 
@@ -76,6 +76,10 @@ NSString * const WCWiredProtocolErrorDomain		= @"WCWiredProtocolErrorDomain";
 			case WCWiredClientUserNotFound: 
 				return NSLS(@"User Not Found", @"WCWiredClientUserNotFound title"); 
 				break;
+				
+			case WCWiredClientTransferFileChanged:
+				return NSLS(@"File Changed", @"WCWiredClientTransferFileChanged title");
+				break;
 		}
 	}
 	else if([[self domain] isEqualToString:WCWiredProtocolErrorDomain]) {
@@ -237,6 +241,11 @@ NSString * const WCWiredProtocolErrorDomain		= @"WCWiredProtocolErrorDomain";
 			case WCWiredClientUserNotFound: 
 				return NSLS(@"Could not find the user you referred to. Perhaps that user left before the command could be completed.", @"WCWiredClientUserNotFound description"); 
 				break; 
+				
+			case WCWiredClientTransferFileChanged:
+				return [NSSWF:NSLS(@"The file \u201c%@\u201d changed while it was being uploaded.", @"WCWiredClientTransferFileChanged description (name)"),
+					argument];
+				break;
 		}
 	}
 	else if([[self domain] isEqualToString:WCWiredProtocolErrorDomain]) {
@@ -127,6 +127,8 @@ extern NSString * const					WCPlacePboardType;
 - (IBAction)style:(id)sender;
 - (IBAction)download:(id)sender;
 - (IBAction)upload:(id)sender;
+- (IBAction)syncDownload:(id)sender;
+- (IBAction)syncUpload:(id)sender;
 - (IBAction)getInfo:(id)sender;
 - (IBAction)quickLook:(id)sender;
 - (IBAction)newDocument:(id)sender;
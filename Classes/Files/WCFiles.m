@@ -64,6 +64,8 @@ NSString * const							WCPlacePboardType = @"WCPlacePboardType";
 - (BOOL)_validateConnected;
 - (BOOL)_validateDownload;
 - (BOOL)_validateUploadToDirectory:(WCFile *)directory;
+- (BOOL)_validateSyncDownload;
+- (BOOL)_validateSyncUploadToDirectory:(WCFile *)directory;
 - (BOOL)_validateGetInfo;
 - (BOOL)_validateQuickLook;
 - (BOOL)_validateCreateFolder;
@@ -352,6 +354,34 @@ NSString * const							WCPlacePboardType = @"WCPlacePboardType";
 
 
 
+- (BOOL)_validateSyncDownload {
+	NSEnumerator	*enumerator;
+	WCFile			*file;
+	
+	if(![self _validateDownload])
+		return NO;
+	
+	enumerator = [[self _selectedFiles] objectEnumerator];
+	
+	while((file = [enumerator nextObject])) {
+		if(![file isFolder])
+			return NO;
+	}
+	
+	return YES;
+}
+
+
+
+- (BOOL)_validateSyncUploadToDirectory:(WCFile *)directory {
+	if(![self _validateUploadToDirectory:directory])
+		return NO;
+	
+	return [[self _selectedAccount] transferUploadDirectories];
+}
+
+
+
 - (BOOL)_validateGetInfo {
 	WCAccount		*account;
 	
@@ -2219,6 +2249,10 @@ NSString * const							WCPlacePboardType = @"WCPlacePboardType";
 		return [self _validateQuickLook];
 	else if(selector == @selector(label:))
 		return [self _validateSetLabel];
+	else if(selector == @selector(syncDownload:))
+		return [self _validateSyncDownload];
+	else if(selector == @selector(syncUpload:))
+		return [self _validateSyncUploadToDirectory:_currentDirectory];
 	
 	return YES;
 }
@@ -2442,6 +2476,53 @@ NSString * const							WCPlacePboardType = @"WCPlacePboardType";
 
 
 
+- (IBAction)syncDownload:(id)sender {
+	if(![self _validateSyncDownload])
+		return;
+	
+	[[WCTransfers transfers] syncFiles:[self _selectedFiles] dryRun:[[NSApp currentEvent] alternateKeyModifier]];
+}
+
+
+
+- (IBAction)syncUpload:(id)sender {
+	NSOpenPanel		*openPanel;
+	
+	if(![self _validateSyncUploadToDirectory:_currentDirectory])
+		return;
+	
+	openPanel = [NSOpenPanel openPanel];
+	
+	[openPanel setCanChooseDirectories:YES];
+	[openPanel setCanChooseFiles:NO];
+	[openPanel setAllowsMultipleSelection:YES];
+	
+	[openPanel beginSheetForDirectory:NULL
+								 file:NULL
+								types:NULL
+					   modalForWindow:[self window]
+						modalDelegate:self
+					   didEndSelector:@selector(syncUploadOpenPanelDidEnd:returnCode:contextInfo:)
+						  contextInfo:[[NSNumber alloc] initWithBool:[[NSApp currentEvent] alternateKeyModifier]]];
+}
+
+
+
+- (void)syncUploadOpenPanelDidEnd:(NSOpenPanel *)openPanel returnCode:(NSInteger)returnCode contextInfo:(void  *)contextInfo {
+	NSNumber		*dryRun = contextInfo;
+	NSArray			*paths;
+	
+	if(returnCode == NSOKButton) {
+		paths = [[openPanel filenames] sortedArrayUsingSelector:@selector(finderCompare:)];
+		
+		[[WCTransfers transfers] syncPaths:paths toFolder:_currentDirectory dryRun:[dryRun boolValue]];
+	}
+	
+	[dryRun release];
+}
+
+
+
 - (IBAction)getInfo:(id)sender {
 	NSEnumerator		*enumerator;
 	NSArray				*files;
@@ -100,6 +100,12 @@ extern NSString * const						WCBookmarksStatus;
 extern NSString * const						WCBookmarksAutoConnect;
 extern NSString * const						WCBookmarksAutoReconnect;
 extern NSString * const						WCBookmarksTheme;
+extern NSString * const						WCBookmarksTransferStreams;
+extern NSString * const						WCBookmarksTransferDownloadSlots;
+extern NSString * const						WCBookmarksTransferUploadSlots;
+extern NSString * const						WCBookmarksTransferQueuePolicy;
+extern NSString * const						WCBookmarksDownloadSpeedLimit;
+extern NSString * const						WCBookmarksUploadSpeedLimit;
 
 extern NSString * const						WCChatHistoryScrollback;
 extern NSString * const						WCChatHistoryScrollbackModifier;
@@ -158,6 +164,26 @@ extern NSString * const						WCOpenFoldersInNewWindows;
 extern NSString * const						WCQueueTransfers;
 extern NSString * const						WCCheckForResourceForks;
 extern NSString * const						WCRemoveTransfers;
+extern NSString * const						WCTransferStreams;
+extern NSString * const						WCTransferDownloadBufferSize;
+extern NSString * const						WCTransferDownloadBufferCount;
+extern NSString * const						WCTransferUploadBufferSize;
+extern NSString * const						WCTransferUploadBufferCount;
+extern NSString * const						WCTransferDownloadSpeedLimit;
+extern NSString * const						WCTransferUploadSpeedLimit;
+extern NSString * const						WCTransferWorkers;
+extern NSString * const						WCTransferConnectionIdleTimeout;
+extern NSString * const						WCTransferUploadPipelineWindow;
+extern NSString * const						WCTransferDownloadSlots;
+extern NSString * const						WCTransferUploadSlots;
+extern NSString * const						WCTransferQueuePolicy;
+extern NSString * const						WCTransferBenchmarks;
+
+enum {
+	WCTransferQueuePolicyFIFO				= 0,
+	WCTransferQueuePolicyShortestRemaining	= 1
+};
+
 extern NSString * const						WCFilesStyle;
 
 enum {
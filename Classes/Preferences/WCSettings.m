@@ -120,6 +120,12 @@ NSString * const WCBookmarksStatus						= @"Status";
 NSString * const WCBookmarksAutoConnect					= @"AutoJoin";
 NSString * const WCBookmarksAutoReconnect				= @"AutoReconnect";
 NSString * const WCBookmarksTheme						= @"Theme";
+NSString * const WCBookmarksTransferStreams				= @"TransferStreams";
+NSString * const WCBookmarksTransferDownloadSlots		= @"TransferDownloadSlots";
+NSString * const WCBookmarksTransferUploadSlots			= @"TransferUploadSlots";
+NSString * const WCBookmarksTransferQueuePolicy			= @"TransferQueuePolicy";
+NSString * const WCBookmarksDownloadSpeedLimit			= @"DownloadSpeedLimit";
+NSString * const WCBookmarksUploadSpeedLimit				= @"UploadSpeedLimit";
 
 NSString * const WCChatHistoryScrollback				= @"WCHistoryScrollback";
 NSString * const WCChatHistoryScrollbackModifier		= @"WCHistoryScrollbackModifier";
@@ -151,6 +157,20 @@ NSString * const WCOpenFoldersInNewWindows				= @"WCOpenFoldersInNewWindows";
 NSString * const WCQueueTransfers						= @"WCQueueTransfers";
 NSString * const WCCheckForResourceForks				= @"WCCheckForResourceForks";
 NSString * const WCRemoveTransfers						= @"WCRemoveTransfers";
+NSString * const WCTransferStreams						= @"WCTransferStreams";
+NSString * const WCTransferDownloadBufferSize			= @"WCTransferDownloadBufferSize";
+NSString * const WCTransferDownloadBufferCount			= @"WCTransferDownloadBufferCount";
+NSString * const WCTransferUploadBufferSize				= @"WCTransferUploadBufferSize";
+NSString * const WCTransferUploadBufferCount			= @"WCTransferUploadBufferCount";
+NSString * const WCTransferDownloadSpeedLimit			= @"WCTransferDownloadSpeedLimit";
+NSString * const WCTransferUploadSpeedLimit				= @"WCTransferUploadSpeedLimit";
+NSString * const WCTransferWorkers						= @"WCTransferWorkers";
+NSString * const WCTransferConnectionIdleTimeout		= @"WCTransferConnectionIdleTimeout";
+NSString * const WCTransferUploadPipelineWindow			= @"WCTransferUploadPipelineWindow";
+NSString * const WCTransferDownloadSlots				= @"WCTransferDownloadSlots";
+NSString * const WCTransferUploadSlots					= @"WCTransferUploadSlots";
+NSString * const WCTransferQueuePolicy					= @"WCTransferQueuePolicy";
+NSString * const WCTransferBenchmarks					= @"WCTransferBenchmarks";
 NSString * const WCFilesStyle							= @"WCFilesStyle";
 
 NSString * const WCTrackerBookmarks						= @"WCTrackerBookmarks";
@@ -746,6 +766,34 @@ NSString * const WCDebug								= @"WCDebug";
 				WCCheckForResourceForks,
 			[NSNumber numberWithBool:NO],
 				WCRemoveTransfers,
+			[NSNumber numberWithInt:1],
+				WCTransferStreams,
+			[NSNumber numberWithInt:1048576],
+				WCTransferDownloadBufferSize,
+			[NSNumber numberWithInt:8],
+				WCTransferDownloadBufferCount,
+			[NSNumber numberWithInt:4194304],
+				WCTransferUploadBufferSize,
+			[NSNumber numberWithInt:4],
+				WCTransferUploadBufferCount,
+			[NSNumber numberWithInt:0],
+				WCTransferDownloadSpeedLimit,
+			[NSNumber numberWithInt:0],
+				WCTransferUploadSpeedLimit,
+			[NSNumber numberWithInt:8],
+				WCTransferWorkers,
+			[NSNumber numberWithInt:30],
+				WCTransferConnectionIdleTimeout,
+			[NSNumber numberWithInt:32],
+				WCTransferUploadPipelineWindow,
+			[NSNumber numberWithInt:1],
+				WCTransferDownloadSlots,
+			[NSNumber numberWithInt:1],
+				WCTransferUploadSlots,
+			[NSNumber numberWithInt:WCTransferQueuePolicyFIFO],
+				WCTransferQueuePolicy,
+			[NSNumber numberWithBool:NO],
+				WCTransferBenchmarks,
 			[NSNumber numberWithInt:WCFilesStyleList],
 				WCFilesStyle,
 			
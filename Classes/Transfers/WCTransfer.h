@@ -47,15 +47,19 @@ enum _WCTransferState {
 typedef enum _WCTransferState			WCTransferState;
 
 
-@class WCFile, WCServerConnection, WCTransferConnection;
+@class WCFile, WCServerConnection, WCTransferConnection, WCTransferFileQueue, WCTransferManifest;
 
 @interface WCTransfer : WCServerConnectionObject <NSCoding, NSCopying> {
 	NSString							*_identifier;
 	
 	WCTransferState						_state;
 	NSUInteger							_queuePosition;
+	NSInteger							_priority;
 	NSUInteger							_transaction;
 	BOOL								_folder;
+	BOOL								_listing;
+	BOOL								_sync;
+	BOOL								_dryRun;
 	WCTransferConnection				*_transferConnection;
 	NSString							*_name;
 	NSString							*_localPath;
@@ -69,13 +73,40 @@ typedef enum _WCTransferState			WCTransferState;
 	NSTimeInterval						_accumulatedTime;
 	NSUInteger							_speedLimit;
 	
-	NSMutableArray						*_untransferredFilesList, *_transferredFilesList;
-	NSMutableSet						*_untransferredFilesSet, *_transferredFilesSet;
-	NSMutableArray						*_uncreatedDirectoriesList, *_createdDirectoriesList;
-	NSMutableSet						*_uncreatedDirectoriesSet, *_createdDirectoriesSet;
+	WCTransferFileQueue					*_untransferredFiles, *_transferredFiles;
+	WCTransferFileQueue					*_uncreatedDirectories, *_createdDirectories;
+	NSData								*_archivedFiles;
+	NSUInteger							_archivedUntransferredFilesCount;
+	NSUInteger							_archivedTransferredFilesCount;
 	
 	NSConditionLock						*_terminationLock;
 	
+	NSRecursiveLock						*_lock;
+	NSMutableSet						*_claimedFilesSet;
+	NSMutableDictionary					*_manifests;
+	NSMutableArray						*_syncChanges;
+	NSMutableSet						*_replacedPaths;
+	WIFileOffset						_syncSize;
+	NSMutableArray						*_streamConnections;
+	NSUInteger							_streams;
+	WCError								*_streamError;
+	
+	NSTimeInterval						_readStallTime;
+	NSTimeInterval						_writeStallTime;
+	NSUInteger							_chunkSize;
+	NSTimeInterval						_framingTime;
+	NSTimeInterval						_roundTripTime;
+	NSTimeInterval						_CPUTime;
+	NSTimeInterval						_requestTime;
+	NSTimeInterval						_timeToFirstByte;
+	
+	WIFileOffset						_sampledTransferred;
+	WCTransferState						_sampledState;
+	
+	BOOL								_statsSampled;
+	WIFileOffset						_statsTransferred;
+	NSTimeInterval						_statsStallTime;
+	
 @public
 	wi_speed_calculator_t				*_speedCalculator;
 	double								_speed;
@@ -94,6 +125,8 @@ typedef enum _WCTransferState			WCTransferState;
 - (WCTransferState)state;
 - (void)setQueuePosition:(NSUInteger)queuePosition;
 - (NSUInteger)queuePosition;
+- (void)setPriority:(NSInteger)priority;
+- (NSInteger)priority;
 - (void)setTransaction:(NSUInteger)transaction;
 - (NSUInteger)transaction;
 - (void)setSpeed:(double)speed;
@@ -108,12 +141,33 @@ typedef enum _WCTransferState			WCTransferState;
 - (WIFileOffset)rsrcTransferred;
 - (void)setActualTransferred:(WIFileOffset)actualTransferred;
 - (WIFileOffset)actualTransferred;
+- (void)addDataTransferred:(WIFileOffset)transferred;
+- (void)addRsrcTransferred:(WIFileOffset)transferred;
+- (void)rewindDataTransferred:(WIFileOffset)transferred;
+- (BOOL)refreshProgress;
 
 - (void)setFolder:(BOOL)value;
 - (BOOL)isFolder;
+- (void)setListing:(BOOL)listing;
+- (BOOL)isListing;
+- (void)setSync:(BOOL)sync;
+- (BOOL)isSync;
+- (void)setDryRun:(BOOL)dryRun;
+- (BOOL)isDryRun;
+- (void)addSyncChange:(NSString *)change size:(WIFileOffset)size;
+- (void)removeAllSyncChanges;
+- (NSArray *)syncChanges;
+- (WIFileOffset)syncSize;
+- (void)addReplacedPath:(NSString *)path;
+- (BOOL)containsReplacedPath:(NSString *)path;
+- (NSArray *)replacedPaths;
+- (void)removeAllReplacedPaths;
 
 - (void)setTransferConnection:(WCTransferConnection *)transferConnection;
 - (WCTransferConnection *)transferConnection;
+- (void)addStreamConnection:(WCTransferConnection *)connection;
+- (void)removeStreamConnection:(WCTransferConnection *)connection;
+- (NSArray *)streamConnections;
 - (void)setName:(NSString *)name;
 - (NSString *)name;
 - (void)setLocalPath:(NSString *)path;
@@ -136,6 +190,28 @@ typedef enum _WCTransferState			WCTransferState;
 - (BOOL)waitUntilTerminatedBeforeDate:(NSDate *)date;
 - (NSImage *)icon;
 - (void)refreshSpeedLimit;
+- (void)addSpeedBytes:(NSUInteger)bytes atTime:(NSTimeInterval)time;
+- (void)addReadStallTime:(NSTimeInterval)readStallTime writeStallTime:(NSTimeInterval)writeStallTime;
+- (NSTimeInterval)readStallTime;
+- (NSTimeInterval)writeStallTime;
+- (void)setChunkSize:(NSUInteger)chunkSize;
+- (NSUInteger)chunkSize;
+- (void)addFramingTime:(NSTimeInterval)framingTime;
+- (NSTimeInterval)framingTime;
+- (void)setRoundTripTime:(NSTimeInterval)roundTripTime;
+- (NSTimeInterval)roundTripTime;
+- (void)addCPUTime:(NSTimeInterval)CPUTime;
+- (NSTimeInterval)CPUTime;
+- (void)setRequestTime:(NSTimeInterval)requestTime;
+- (void)setFirstByteTime:(NSTimeInterval)firstByteTime;
+- (NSTimeInterval)timeToFirstByte;
+- (void)getStatsTransferred:(WIFileOffset *)transferred stallTime:(NSTimeInterval *)stallTime;
+
+- (BOOL)beginStreamWithLimit:(NSUInteger)limit;
+- (BOOL)beginAdditionalStreamWithLimit:(NSUInteger)limit;
+- (NSUInteger)endStreamWithError:(WCError *)error;
+- (NSUInteger)numberOfStreams;
+- (WCError *)streamError;
 
 - (BOOL)containsUntransferredFile:(WCFile *)file;
 - (BOOL)containsTransferredFile:(WCFile *)file;
@@ -145,6 +221,11 @@ typedef enum _WCTransferState			WCTransferState;
 - (NSUInteger)numberOfUntransferredFiles;
 - (NSUInteger)numberOfTransferredFiles;
 - (WCFile *)firstUntransferredFile;
+- (WCFile *)untransferredFileAfterFile:(WCFile *)file;
+- (WCFile *)claimNextUntransferredFile;
+- (void)unclaimFile:(WCFile *)file;
+- (void)setManifest:(WCTransferManifest *)manifest forFile:(WCFile *)file;
+- (WCTransferManifest *)manifestForFile:(WCFile *)file;
 - (void)addUntransferredFile:(WCFile *)file;
 - (void)removeUntransferredFile:(WCFile *)file;
 - (void)addTransferredFile:(WCFile *)file;
@@ -155,6 +236,8 @@ typedef enum _WCTransferState			WCTransferState;
 - (void)removeAllUncreatedDirectories;
 - (void)addCreatedDirectory:(WCFile *)directory;
 - (void)removeCreatedDirectory:(WCFile *)directory;
+- (NSUInteger)numberOfUncreatedDirectories;
+- (NSUInteger)numberOfCreatedDirectories;
 - (NSArray *)uncreatedDirectories;
 - (NSArray *)createdDirectories;
 
@@ -31,12 +31,16 @@
 #import "WCServer.h"
 #import "WCServerConnection.h"
 #import "WCTransfer.h"
+#import "WCTransferFileQueue.h"
 
 @interface WCTransfer(Private)
 
 - (id)_initWithConnection:(WCServerConnection *)connection;
 - (id)_initWithMessage:(WIP7Message *)message connection:(WCServerConnection *)connection;
 
+- (void)_loadFiles;
+- (NSData *)_archivedFiles;
+
 @end
 
 
@@ -47,15 +51,11 @@
 	
 	[self setState:WCTransferWaiting];
 
-	_untransferredFilesList		= [[NSMutableArray alloc] init];
-	_transferredFilesList		= [[NSMutableArray alloc] init];
-	_untransferredFilesSet		= [[NSMutableSet alloc] init];
-	_transferredFilesSet		= [[NSMutableSet alloc] init];
+	_untransferredFiles			= [[WCTransferFileQueue alloc] init];
+	_transferredFiles			= [[WCTransferFileQueue alloc] init];
 
-	_uncreatedDirectoriesList	= [[NSMutableArray alloc] init];
-	_createdDirectoriesList		= [[NSMutableArray alloc] init];
-	_uncreatedDirectoriesSet	= [[NSMutableSet alloc] init];
-	_createdDirectoriesSet		= [[NSMutableSet alloc] init];
+	_uncreatedDirectories		= [[WCTransferFileQueue alloc] init];
+	_createdDirectories			= [[WCTransferFileQueue alloc] init];
 	
 	[self refreshSpeedLimit];
 	
@@ -96,13 +96,80 @@
 	return self;
 }
 
+
+
+#pragma mark -
+
+- (void)_loadFiles {
+	NSArray		*lists;
+	
+	if(!_archivedFiles)
+		return;
+	
+	[_lock lock];
+	
+	if(_archivedFiles) {
+		lists = [NSKeyedUnarchiver unarchiveObjectWithData:_archivedFiles];
+		
+		if([lists count] == 4) {
+			[_untransferredFiles release];
+			[_transferredFiles release];
+			[_uncreatedDirectories release];
+			[_createdDirectories release];
+			
+			_untransferredFiles			= [[WCTransferFileQueue alloc] initWithArray:[lists objectAtIndex:0]];
+			_transferredFiles			= [[WCTransferFileQueue alloc] initWithArray:[lists objectAtIndex:1]];
+			_uncreatedDirectories		= [[WCTransferFileQueue alloc] initWithArray:[lists objectAtIndex:2]];
+			_createdDirectories			= [[WCTransferFileQueue alloc] initWithArray:[lists objectAtIndex:3]];
+			
+			if([self connection]) {
+				[_untransferredFiles makeFilesPerformSelector:@selector(setConnection:) withObject:[self connection]];
+				[_transferredFiles makeFilesPerformSelector:@selector(setConnection:) withObject:[self connection]];
+				[_uncreatedDirectories makeFilesPerformSelector:@selector(setConnection:) withObject:[self connection]];
+				[_createdDirectories makeFilesPerformSelector:@selector(setConnection:) withObject:[self connection]];
+			}
+		}
+		
+		[_archivedFiles release];
+		_archivedFiles = NULL;
+	}
+	
+	[_lock unlock];
+}
+
+
+
+- (NSData *)_archivedFiles {
+	NSArray		*lists;
+	NSData		*data;
+	
+	[_lock lock];
+	
+	if(_archivedFiles) {
+		data = [[_archivedFiles retain] autorelease];
+	} else {
+		lists = [NSArray arrayWithObjects:
+			[_untransferredFiles files],
+			[_transferredFiles files],
+			[_uncreatedDirectories files],
+			[_createdDirectories files],
+			NULL];
+		
+		data = [NSKeyedArchiver archivedDataWithRootObject:lists];
+	}
+	
+	[_lock unlock];
+	
+	return data;
+}
+
 @end
 
 
 @implementation WCTransfer
 
 + (NSInteger)version {
-	return 2;
+	return 3;
 }
 
 
@@ -146,6 +213,13 @@
 	
 	_terminationLock = [[NSConditionLock alloc] initWithCondition:0];
 	
+	_lock = [[NSRecursiveLock alloc] init];
+	_claimedFilesSet = [[NSMutableSet alloc] init];
+	_manifests = [[NSMutableDictionary alloc] init];
+	_syncChanges = [[NSMutableArray alloc] init];
+	_replacedPaths = [[NSMutableSet alloc] init];
+	_streamConnections = [[NSMutableArray alloc] init];
+	
 	_speedCalculator = wi_speed_calculator_init_with_capacity(wi_speed_calculator_alloc(), 50);
 	
 	return self;
@@ -167,18 +241,23 @@
 	
 	[_progressIndicator release];
 
-	[_untransferredFilesList release];
-	[_transferredFilesList release];
-	[_untransferredFilesSet release];
-	[_transferredFilesSet release];
+	[_untransferredFiles release];
+	[_transferredFiles release];
 
-	[_uncreatedDirectoriesList release];
-	[_createdDirectoriesList release];
-	[_uncreatedDirectoriesSet release];
-	[_createdDirectoriesSet release];
+	[_uncreatedDirectories release];
+	[_createdDirectories release];
+	[_archivedFiles release];
 	
 	[_terminationLock release];
 	
+	[_lock release];
+	[_claimedFilesSet release];
+	[_manifests release];
+	[_syncChanges release];
+	[_replacedPaths release];
+	[_streamConnections release];
+	[_streamError release];
+	
 	wi_release(_speedCalculator);
 
 	[super dealloc];
@@ -204,20 +283,34 @@
 	}
 	
 	_state						= [coder decodeIntForKey:@"WCTransferState"];
+	_priority					= [coder decodeIntForKey:@"WCTransferPriority"];
 	_folder						= [coder decodeBoolForKey:@"WCTransferFolder"];
+	_sync						= [coder decodeBoolForKey:@"WCTransferSync"];
+	_dryRun						= [coder decodeBoolForKey:@"WCTransferDryRun"];
+	_syncSize					= [coder decodeInt64ForKey:@"WCTransferSyncSize"];
+	
+	[_syncChanges addObjectsFromArray:[coder decodeObjectForKey:@"WCTransferSyncChanges"]];
 	_name						= [[coder decodeObjectForKey:@"WCTransferName"] retain];
 	_localPath					= [[coder decodeObjectForKey:@"WCTransferLocalPath"] retain];
 	_remotePath					= [[coder decodeObjectForKey:@"WCTransferRemotePath"] retain];
 	_destinationPath			= [[coder decodeObjectForKey:@"WCTransferDestinationPath"] retain];
 	_file						= [[coder decodeObjectForKey:@"WCTransferFile"] retain];
-	_untransferredFilesList		= [[coder decodeObjectForKey:@"WCTransferUntransferredFilesList"] retain];
-	_transferredFilesList		= [[coder decodeObjectForKey:@"WCTransferTransferredFilesList"] retain];
-	_untransferredFilesSet		= [[coder decodeObjectForKey:@"WCTransferUntransferredFilesSet"] retain];
-	_transferredFilesSet		= [[coder decodeObjectForKey:@"WCTransferTransferredFilesSet"] retain];
-	_uncreatedDirectoriesList	= [[coder decodeObjectForKey:@"WCTransferUncreatedDirectoriesList"] retain];
-	_createdDirectoriesList		= [[coder decodeObjectForKey:@"WCTransferCreatedDirectoriesList"] retain];
-	_uncreatedDirectoriesSet	= [[coder decodeObjectForKey:@"WCTransferUncreatedDirectoriesSet"] retain];
-	_createdDirectoriesSet		= [[coder decodeObjectForKey:@"WCTransferCreatedDirectoriesSet"] retain];
+	
+	if(version > 2) {
+		_untransferredFiles					= [[WCTransferFileQueue alloc] init];
+		_transferredFiles					= [[WCTransferFileQueue alloc] init];
+		_uncreatedDirectories				= [[WCTransferFileQueue alloc] init];
+		_createdDirectories					= [[WCTransferFileQueue alloc] init];
+		_archivedFiles						= [[coder decodeObjectForKey:@"WCTransferFiles"] retain];
+		_archivedUntransferredFilesCount	= [coder decodeInt64ForKey:@"WCTransferUntransferredFilesCount"];
+		_archivedTransferredFilesCount		= [coder decodeInt64ForKey:@"WCTransferTransferredFilesCount"];
+	} else {
+		_untransferredFiles					= [[WCTransferFileQueue alloc] initWithArray:[coder decodeObjectForKey:@"WCTransferUntransferredFilesList"]];
+		_transferredFiles					= [[WCTransferFileQueue alloc] initWithArray:[coder decodeObjectForKey:@"WCTransferTransferredFilesList"]];
+		_uncreatedDirectories				= [[WCTransferFileQueue alloc] initWithArray:[coder decodeObjectForKey:@"WCTransferUncreatedDirectoriesList"]];
+		_createdDirectories					= [[WCTransferFileQueue alloc] initWithArray:[coder decodeObjectForKey:@"WCTransferCreatedDirectoriesList"]];
+	}
+	
 	_dataTransferred			= [coder decodeInt64ForKey:@"WCTransferDataTransferred"];
 	_rsrcTransferred			= [coder decodeInt64ForKey:@"WCTransferRsrcTransferred"];
 	_actualTransferred			= [coder decodeInt64ForKey:@"WCTransferActualTransferred"];
@@ -241,20 +334,20 @@
 	
 	[coder encodeObject:_identifier forKey:@"WCTransferIdentifier"];
 	[coder encodeInt:_state forKey:@"WCTransferState"];
+	[coder encodeInt:_priority forKey:@"WCTransferPriority"];
 	[coder encodeBool:_folder forKey:@"WCTransferFolder"];
+	[coder encodeBool:_sync forKey:@"WCTransferSync"];
+	[coder encodeBool:_dryRun forKey:@"WCTransferDryRun"];
+	[coder encodeInt64:_syncSize forKey:@"WCTransferSyncSize"];
+	[coder encodeObject:[self syncChanges] forKey:@"WCTransferSyncChanges"];
 	[coder encodeObject:_name forKey:@"WCTransferName"];
 	[coder encodeObject:_localPath forKey:@"WCTransferLocalPath"];
 	[coder encodeObject:_remotePath forKey:@"WCTransferRemotePath"];
 	[coder encodeObject:_destinationPath forKey:@"WCTransferDestinationPath"];
 	[coder encodeObject:_file forKey:@"WCTransferFile"];
-	[coder encodeObject:_untransferredFilesList forKey:@"WCTransferUntransferredFilesList"];
-	[coder encodeObject:_transferredFilesList forKey:@"WCTransferTransferredFilesList"];
-	[coder encodeObject:_untransferredFilesSet forKey:@"WCTransferUntransferredFilesSet"];
-	[coder encodeObject:_transferredFilesSet forKey:@"WCTransferTransferredFilesSet"];
-	[coder encodeObject:_uncreatedDirectoriesList forKey:@"WCTransferUncreatedDirectoriesList"];
-	[coder encodeObject:_createdDirectoriesList forKey:@"WCTransferCreatedDirectoriesList"];
-	[coder encodeObject:_uncreatedDirectoriesSet forKey:@"WCTransferUncreatedDirectoriesSet"];
-	[coder encodeObject:_createdDirectoriesSet forKey:@"WCTransferCreatedDirectoriesSet"];
+	[coder encodeObject:[self _archivedFiles] forKey:@"WCTransferFiles"];
+	[coder encodeInt64:[self numberOfUntransferredFiles] forKey:@"WCTransferUntransferredFilesCount"];
+	[coder encodeInt64:[self numberOfTransferredFiles] forKey:@"WCTransferTransferredFilesCount"];
 	[coder encodeInt64:_dataTransferred forKey:@"WCTransferDataTransferred"];
 	[coder encodeInt64:_rsrcTransferred forKey:@"WCTransferRsrcTransferred"];
 	[coder encodeInt64:_actualTransferred forKey:@"WCTransferActualTransferred"];
@@ -281,15 +374,13 @@
 #pragma mark -
 
 - (void)setConnection:(WCServerConnection *)connection {
-	[_untransferredFilesList makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_transferredFilesList makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_untransferredFilesSet makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_transferredFilesSet makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
+	[_lock lock];
+	[_untransferredFiles makeFilesPerformSelector:@selector(setConnection:) withObject:connection];
+	[_transferredFiles makeFilesPerformSelector:@selector(setConnection:) withObject:connection];
 
-	[_uncreatedDirectoriesList makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_createdDirectoriesList makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_uncreatedDirectoriesSet makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
-	[_createdDirectoriesSet makeObjectsPerformSelector:@selector(setConnection:) withObject:connection];
+	[_uncreatedDirectories makeFilesPerformSelector:@selector(setConnection:) withObject:connection];
+	[_createdDirectories makeFilesPerformSelector:@selector(setConnection:) withObject:connection];
+	[_lock unlock];
 
 	[super setConnection:connection];
 }
@@ -346,6 +437,18 @@
 
 
 
+- (void)setPriority:(NSInteger)priority {
+	_priority = priority;
+}
+
+
+
+- (NSInteger)priority {
+	return _priority;
+}
+
+
+
 - (void)setTransaction:(NSUInteger)transaction {
 	_transaction = transaction;
 }
@@ -430,6 +533,46 @@
 
 
 
+- (void)addDataTransferred:(WIFileOffset)transferred {
+	OSAtomicAdd64Barrier(transferred, (volatile int64_t *) &_dataTransferred);
+	OSAtomicAdd64Barrier(transferred, (volatile int64_t *) &_actualTransferred);
+}
+
+
+
+- (void)addRsrcTransferred:(WIFileOffset)transferred {
+	OSAtomicAdd64Barrier(transferred, (volatile int64_t *) &_rsrcTransferred);
+	OSAtomicAdd64Barrier(transferred, (volatile int64_t *) &_actualTransferred);
+}
+
+
+
+- (void)rewindDataTransferred:(WIFileOffset)transferred {
+	OSAtomicAdd64Barrier(-(int64_t) transferred, (volatile int64_t *) &_dataTransferred);
+}
+
+
+
+- (BOOL)refreshProgress {
+	WIFileOffset		transferred;
+	
+	transferred = OSAtomicAdd64Barrier(0, (volatile int64_t *) &_dataTransferred) +
+				  OSAtomicAdd64Barrier(0, (volatile int64_t *) &_rsrcTransferred);
+	
+	if(transferred == _sampledTransferred && _state == _sampledState)
+		return NO;
+	
+	_sampledTransferred		= transferred;
+	_sampledState			= _state;
+	
+	if(_size > 0)
+		[_progressIndicator setDoubleValue:(double) transferred / (double) _size];
+	
+	return YES;
+}
+
+
+
 #pragma mark -
 
 - (void)setFolder:(BOOL)folder {
@@ -444,6 +587,118 @@
 
 
 
+- (void)setListing:(BOOL)listing {
+	_listing = listing;
+}
+
+
+
+- (BOOL)isListing {
+	return _listing;
+}
+
+
+
+- (void)setSync:(BOOL)sync {
+	_sync = sync;
+}
+
+
+
+- (BOOL)isSync {
+	return _sync;
+}
+
+
+
+- (void)setDryRun:(BOOL)dryRun {
+	_dryRun = dryRun;
+}
+
+
+
+- (BOOL)isDryRun {
+	return _dryRun;
+}
+
+
+
+- (void)addSyncChange:(NSString *)change size:(WIFileOffset)size {
+	[_lock lock];
+	[_syncChanges addObject:change];
+	_syncSize += size;
+	[_lock unlock];
+}
+
+
+
+- (void)removeAllSyncChanges {
+	[_lock lock];
+	[_syncChanges removeAllObjects];
+	_syncSize = 0;
+	[_lock unlock];
+}
+
+
+
+- (NSArray *)syncChanges {
+	NSArray		*changes;
+	
+	[_lock lock];
+	changes = [[_syncChanges copy] autorelease];
+	[_lock unlock];
+	
+	return changes;
+}
+
+
+
+- (WIFileOffset)syncSize {
+	return _syncSize;
+}
+
+
+
+- (void)addReplacedPath:(NSString *)path {
+	[_lock lock];
+	[_replacedPaths addObject:path];
+	[_lock unlock];
+}
+
+
+
+- (BOOL)containsReplacedPath:(NSString *)path {
+	BOOL		contains;
+	
+	[_lock lock];
+	contains = [_replacedPaths containsObject:path];
+	[_lock unlock];
+	
+	return contains;
+}
+
+
+
+- (NSArray *)replacedPaths {
+	NSArray		*paths;
+	
+	[_lock lock];
+	paths = [_replacedPaths allObjects];
+	[_lock unlock];
+	
+	return paths;
+}
+
+
+
+- (void)removeAllReplacedPaths {
+	[_lock lock];
+	[_replacedPaths removeAllObjects];
+	[_lock unlock];
+}
+
+
+
 #pragma mark -
 
 - (void)setTransferConnection:(WCTransferConnection *)transferConnection {
@@ -461,6 +716,34 @@
 
 
 
+- (void)addStreamConnection:(WCTransferConnection *)connection {
+	[_lock lock];
+	[_streamConnections addObject:connection];
+	[_lock unlock];
+}
+
+
+
+- (void)removeStreamConnection:(WCTransferConnection *)connection {
+	[_lock lock];
+	[_streamConnections removeObject:connection];
+	[_lock unlock];
+}
+
+
+
+- (NSArray *)streamConnections {
+	NSArray		*connections;
+	
+	[_lock lock];
+	connections = [[_streamConnections copy] autorelease];
+	[_lock unlock];
+	
+	return connections;
+}
+
+
+
 - (void)setName:(NSString *)name {
 	[name retain];
 	[_name release];
@@ -621,28 +904,305 @@
 
 
 
+- (void)addSpeedBytes:(NSUInteger)bytes atTime:(NSTimeInterval)time {
+	[_lock lock];
+	
+	wi_speed_calculator_add_bytes_at_time(_speedCalculator, bytes, time);
+	
+	_speed = wi_speed_calculator_speed(_speedCalculator);
+
+	[_lock unlock];
+}
+
+
+
+- (void)addReadStallTime:(NSTimeInterval)readStallTime writeStallTime:(NSTimeInterval)writeStallTime {
+	[_lock lock];
+	
+	_readStallTime += readStallTime;
+	_writeStallTime += writeStallTime;
+	
+	[_lock unlock];
+}
+
+
+
+- (NSTimeInterval)readStallTime {
+	NSTimeInterval		readStallTime;
+	
+	[_lock lock];
+	readStallTime = _readStallTime;
+	[_lock unlock];
+	
+	return readStallTime;
+}
+
+
+
+- (NSTimeInterval)writeStallTime {
+	NSTimeInterval		writeStallTime;
+	
+	[_lock lock];
+	writeStallTime = _writeStallTime;
+	[_lock unlock];
+	
+	return writeStallTime;
+}
+
+
+
+- (void)setChunkSize:(NSUInteger)chunkSize {
+	_chunkSize = chunkSize;
+}
+
+
+
+- (NSUInteger)chunkSize {
+	return _chunkSize;
+}
+
+
+
+- (void)addFramingTime:(NSTimeInterval)framingTime {
+	[_lock lock];
+	_framingTime += framingTime;
+	[_lock unlock];
+}
+
+
+
+- (NSTimeInterval)framingTime {
+	NSTimeInterval		framingTime;
+	
+	[_lock lock];
+	framingTime = _framingTime;
+	[_lock unlock];
+	
+	return framingTime;
+}
+
+
+
+- (void)setRoundTripTime:(NSTimeInterval)roundTripTime {
+	[_lock lock];
+	_roundTripTime = roundTripTime;
+	[_lock unlock];
+}
+
+
+
+- (NSTimeInterval)roundTripTime {
+	NSTimeInterval		roundTripTime;
+	
+	[_lock lock];
+	roundTripTime = _roundTripTime;
+	[_lock unlock];
+	
+	return roundTripTime;
+}
+
+
+
+- (void)addCPUTime:(NSTimeInterval)CPUTime {
+	[_lock lock];
+	_CPUTime += CPUTime;
+	[_lock unlock];
+}
+
+
+
+- (NSTimeInterval)CPUTime {
+	NSTimeInterval		CPUTime;
+	
+	[_lock lock];
+	CPUTime = _CPUTime;
+	[_lock unlock];
+	
+	return CPUTime;
+}
+
+
+
+- (void)setRequestTime:(NSTimeInterval)requestTime {
+	[_lock lock];
+	_requestTime = requestTime;
+	_timeToFirstByte = 0.0;
+	[_lock unlock];
+}
+
+
+
+- (void)setFirstByteTime:(NSTimeInterval)firstByteTime {
+	[_lock lock];
+	
+	if(_requestTime > 0.0 && _timeToFirstByte == 0.0)
+		_timeToFirstByte = WIMax(firstByteTime - _requestTime, 0.000001);
+	
+	[_lock unlock];
+}
+
+
+
+- (NSTimeInterval)timeToFirstByte {
+	NSTimeInterval		timeToFirstByte;
+	
+	[_lock lock];
+	timeToFirstByte = _timeToFirstByte;
+	[_lock unlock];
+	
+	return timeToFirstByte;
+}
+
+
+
+- (void)getStatsTransferred:(WIFileOffset *)transferred stallTime:(NSTimeInterval *)stallTime {
+	WIFileOffset		total;
+	NSTimeInterval		stall;
+	
+	total = OSAtomicAdd64Barrier(0, (volatile int64_t *) &_dataTransferred) +
+			OSAtomicAdd64Barrier(0, (volatile int64_t *) &_rsrcTransferred);
+	
+	[_lock lock];
+	
+	stall = _readStallTime + _writeStallTime;
+	
+	if(_statsSampled && total >= _statsTransferred) {
+		*transferred	= total - _statsTransferred;
+		*stallTime		= WIMax(stall - _statsStallTime, 0.0);
+	} else {
+		*transferred	= 0;
+		*stallTime		= 0.0;
+	}
+	
+	_statsSampled		= YES;
+	_statsTransferred	= total;
+	_statsStallTime		= stall;
+	
+	[_lock unlock];
+}
+
+
+
+#pragma mark -
+
+- (BOOL)beginStreamWithLimit:(NSUInteger)limit {
+	BOOL		began;
+	
+	[_lock lock];
+	
+	if(_streams == 0) {
+		[_streamError release];
+		_streamError = NULL;
+	}
+	
+	began = (_streams < limit);
+	
+	if(began)
+		_streams++;
+	
+	[_lock unlock];
+	
+	return began;
+}
+
+
+
+- (BOOL)beginAdditionalStreamWithLimit:(NSUInteger)limit {
+	BOOL		began;
+	
+	[_lock lock];
+	
+	began = (_streams > 0 && _streams < limit);
+	
+	if(began)
+		_streams++;
+	
+	[_lock unlock];
+	
+	return began;
+}
+
+
+
+- (NSUInteger)endStreamWithError:(WCError *)error {
+	NSUInteger		streams;
+	
+	[_lock lock];
+	
+	if(error && !_streamError)
+		_streamError = [error retain];
+	
+	streams = --_streams;
+	
+	[_lock unlock];
+	
+	return streams;
+}
+
+
+
+- (NSUInteger)numberOfStreams {
+	return _streams;
+}
+
+
+
+- (WCError *)streamError {
+	return _streamError;
+}
+
+
+
 #pragma mark -
 
 - (BOOL)containsUntransferredFile:(WCFile *)file {
-	return [_untransferredFilesSet containsObject:file];
+	BOOL		contains;
+	
+	[_lock lock];
+	[self _loadFiles];
+	contains = [_untransferredFiles containsFile:file];
+	[_lock unlock];
+	
+	return contains;
 }
 
 
 
 - (BOOL)containsTransferredFile:(WCFile *)file {
-	return [_transferredFilesSet containsObject:file];
+	BOOL		contains;
+	
+	[_lock lock];
+	[self _loadFiles];
+	contains = [_transferredFiles containsFile:file];
+	[_lock unlock];
+	
+	return contains;
 }
 
 
 
 - (BOOL)containsUncreatedDirectory:(WCFile *)directory {
-	return [_uncreatedDirectoriesSet containsObject:directory];
+	BOOL		contains;
+	
+	[_lock lock];
+	[self _loadFiles];
+	contains = [_uncreatedDirectories containsFile:directory];
+	[_lock unlock];
+	
+	return contains;
 }
 
 
 
 - (BOOL)containsCreatedDirectory:(WCFile *)directory {
-	return [_createdDirectoriesSet containsObject:directory];
+	BOOL		contains;
+	
+	[_lock lock];
+	[self _loadFiles];
+	contains = [_createdDirectories containsFile:directory];
+	[_lock unlock];
+	
+	return contains;
 }
 
 
@@ -650,50 +1210,144 @@
 #pragma mark -
 
 - (NSUInteger)numberOfUntransferredFiles {
-	return [_untransferredFilesList count];
+	NSUInteger		count;
+	
+	[_lock lock];
+	count = _archivedFiles ? _archivedUntransferredFilesCount : [_untransferredFiles count];
+	[_lock unlock];
+	
+	return count;
 }
 
 
 
 - (NSUInteger)numberOfTransferredFiles {
-	return [_transferredFilesList count];
+	NSUInteger		count;
+	
+	[_lock lock];
+	count = _archivedFiles ? _archivedTransferredFilesCount : [_transferredFiles count];
+	[_lock unlock];
+	
+	return count;
 }
 
 
 
 - (WCFile *)firstUntransferredFile {
-	if([_untransferredFilesList count] == 0)
-		return NULL;
+	WCFile		*file;
+	
+	[_lock lock];
+	[self _loadFiles];
+	file = [[[_untransferredFiles firstFile] retain] autorelease];
+	[_lock unlock];
+	
+	return file;
+}
+
+
+
+- (WCFile *)untransferredFileAfterFile:(WCFile *)file {
+	WCFile		*nextFile;
+	
+	[_lock lock];
+	[self _loadFiles];
+	nextFile = [[[_untransferredFiles fileAfterFile:file] retain] autorelease];
+	[_lock unlock];
+	
+	return nextFile;
+}
+
+
+
+- (WCFile *)claimNextUntransferredFile {
+	WCFile		*file;
+	
+	[_lock lock];
+	[self _loadFiles];
 	
-	return [_untransferredFilesList objectAtIndex:0];
+	file = [_untransferredFiles firstFile];
+	
+	while(file && [_claimedFilesSet containsObject:file])
+		file = [_untransferredFiles fileAfterFile:file];
+	
+	if(file) {
+		[_claimedFilesSet addObject:file];
+		[[file retain] autorelease];
+	}
+	
+	[_lock unlock];
+	
+	return file;
+}
+
+
+
+- (void)unclaimFile:(WCFile *)file {
+	[_lock lock];
+	[_claimedFilesSet removeObject:file];
+	[_lock unlock];
+}
+
+
+
+- (void)setManifest:(WCTransferManifest *)manifest forFile:(WCFile *)file {
+	[_lock lock];
+	
+	if(manifest)
+		[_manifests setObject:manifest forKey:[file path]];
+	else
+		[_manifests removeObjectForKey:[file path]];
+	
+	[_lock unlock];
+}
+
+
+
+- (WCTransferManifest *)manifestForFile:(WCFile *)file {
+	WCTransferManifest		*manifest;
+	
+	[_lock lock];
+	manifest = [[[_manifests objectForKey:[file path]] retain] autorelease];
+	[_lock unlock];
+	
+	return manifest;
 }
 
 
 
 - (void)addUntransferredFile:(WCFile *)file {
-	[_untransferredFilesList addObject:file];
-	[_untransferredFilesSet addObject:file];
+	[_lock lock];
+	[self _loadFiles];
+	[_untransferredFiles addFile:file];
+	[_lock unlock];
 }
 
 
 
 - (void)removeUntransferredFile:(WCFile *)file {
-	[_untransferredFilesList removeObject:file];
-	[_untransferredFilesSet removeObject:file];
+	[_lock lock];
+	[self _loadFiles];
+	[_untransferredFiles removeFile:file];
+	[_claimedFilesSet removeObject:file];
+	[_lock unlock];
 }
 
 
 
 - (void)addTransferredFile:(WCFile *)file {
-	[_transferredFilesList addObject:file];
-	[_transferredFilesSet addObject:file];
+	[_lock lock];
+	[self _loadFiles];
+	[_transferredFiles addFile:file];
+	[_lock unlock];
 }
 
 
 
 - (void)removeTransferredFile:(WCFile *)file {
-	[_transferredFilesList removeObject:file];
-	[_transferredFilesSet removeObject:file];
+	[_lock lock];
+	[self _loadFiles];
+	[_transferredFiles removeFile:file];
+	[_lock unlock];
 }
 
 
@@ -701,48 +1355,98 @@
 #pragma mark -
 
 - (void)addUncreatedDirectory:(WCFile *)directory {
-	[_uncreatedDirectoriesList addObject:directory];
-	[_uncreatedDirectoriesSet addObject:directory];
+	[_lock lock];
+	[self _loadFiles];
+	[_uncreatedDirectories addFile:directory];
+	[_lock unlock];
 }
 
 
 
 - (void)removeUncreatedDirectory:(WCFile *)directory {
-	[_uncreatedDirectoriesList removeObject:directory];
-	[_uncreatedDirectoriesSet removeObject:directory];
+	[_lock lock];
+	[self _loadFiles];
+	[_uncreatedDirectories removeFile:directory];
+	[_lock unlock];
 }
 
 
 
 - (void)removeAllUncreatedDirectories {
-	[_uncreatedDirectoriesList removeAllObjects];
-	[_uncreatedDirectoriesSet removeAllObjects];
+	[_lock lock];
+	[self _loadFiles];
+	[_uncreatedDirectories removeAllFiles];
+	[_lock unlock];
 }
 
 
 
 - (void)addCreatedDirectory:(WCFile *)directory {
-	[_createdDirectoriesList addObject:directory];
-	[_createdDirectoriesSet addObject:directory];
+	[_lock lock];
+	[self _loadFiles];
+	[_createdDirectories addFile:directory];
+	[_lock unlock];
 }
 
 
 
 - (void)removeCreatedDirectory:(WCFile *)directory {
-	[_createdDirectoriesList removeObject:directory];
-	[_createdDirectoriesSet removeObject:directory];
+	[_lock lock];
+	[self _loadFiles];
+	[_createdDirectories removeFile:directory];
+	[_lock unlock];
+}
+
+
+
+- (NSUInteger)numberOfUncreatedDirectories {
+	NSUInteger		count;
+	
+	[_lock lock];
+	[self _loadFiles];
+	count = [_uncreatedDirectories count];
+	[_lock unlock];
+	
+	return count;
+}
+
+
+
+- (NSUInteger)numberOfCreatedDirectories {
+	NSUInteger		count;
+	
+	[_lock lock];
+	[self _loadFiles];
+	count = [_createdDirectories count];
+	[_lock unlock];
+	
+	return count;
 }
 
 
 
 - (NSArray *)uncreatedDirectories {
-	return _uncreatedDirectoriesList;
+	NSArray		*directories;
+	
+	[_lock lock];
+	[self _loadFiles];
+	directories = [_uncreatedDirectories files];
+	[_lock unlock];
+	
+	return directories;
 }
 
 
 
 - (NSArray *)createdDirectories {
-	return _createdDirectoriesList;
+	NSArray		*directories;
+	
+	[_lock lock];
+	[self _loadFiles];
+	directories = [_createdDirectories files];
+	[_lock unlock];
+	
+	return directories;
 }
 
 @end
@@ -0,0 +1,205 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#import "WCServerConnection.h"
+#import "WCTransfer.h"
+#import "WCTransferBenchmark.h"
+
+#define WCTransferBenchmarkPath					@"~/Library/Logs/Wired Client Transfers.log"
+#define WCTransferBenchmarkSmallFileSize		1048576.0
+
+enum _WCTransferBenchmarkScenario {
+	_WCTransferBenchmarkLargeFile				= 0,
+	_WCTransferBenchmarkSmallFiles,
+	_WCTransferBenchmarkFolder,
+	_WCTransferBenchmarkTree,
+	_WCTransferBenchmarkResume
+};
+typedef enum _WCTransferBenchmarkScenario		_WCTransferBenchmarkScenario;
+
+
+@interface WCTransferBenchmark(Private)
+
+- (_WCTransferBenchmarkScenario)_scenarioForTransfer:(WCTransfer *)transfer files:(NSUInteger)files;
+- (NSString *)_nameForScenario:(_WCTransferBenchmarkScenario)scenario;
+
+- (void)_writeLine:(NSString *)line;
+
+@end
+
+
+@implementation WCTransferBenchmark(Private)
+
+- (_WCTransferBenchmarkScenario)_scenarioForTransfer:(WCTransfer *)transfer files:(NSUInteger)files {
+	if([transfer actualTransferred] < [transfer size])
+		return _WCTransferBenchmarkResume;
+	
+	if(![transfer isFolder])
+		return _WCTransferBenchmarkLargeFile;
+	
+	if([transfer numberOfCreatedDirectories] > 0)
+		return _WCTransferBenchmarkTree;
+	
+	if(files > 1 && (double) [transfer size] / (double) files < WCTransferBenchmarkSmallFileSize)
+		return _WCTransferBenchmarkSmallFiles;
+	
+	return _WCTransferBenchmarkFolder;
+}
+
+
+
+- (NSString *)_nameForScenario:(_WCTransferBenchmarkScenario)scenario {
+	switch(scenario) {
+		case _WCTransferBenchmarkLargeFile:		return @"file";			break;
+		case _WCTransferBenchmarkSmallFiles:	return @"small files";	break;
+		case _WCTransferBenchmarkFolder:		return @"folder";		break;
+		case _WCTransferBenchmarkTree:			return @"tree";			break;
+		case _WCTransferBenchmarkResume:		return @"resume";		break;
+	}
+	
+	return NULL;
+}
+
+
+
+#pragma mark -
+
+- (void)_writeLine:(NSString *)line {
+	FILE		*fp;
+	BOOL		header;
+	
+	header = ![[NSFileManager defaultManager] fileExistsAtPath:_path];
+	fp = fopen([_path fileSystemRepresentation], "a");
+	
+	if(!fp)
+		return;
+	
+	if(header)
+		fprintf(fp, "date\tdirection\tscenario\tserver\tname\tfiles\tbytes\tseconds\tMB/s\tfiles/s\tCPU s/GB\tTTFB ms\n");
+	
+	fprintf(fp, "%s\n", [line UTF8String]);
+	fclose(fp);
+}
+
+@end
+
+
+
+@implementation WCTransferBenchmark
+
++ (WCTransferBenchmark *)benchmark {
+	static id	sharedBenchmark;
+	
+	if(!sharedBenchmark)
+		sharedBenchmark = [[self alloc] init];
+	
+	return sharedBenchmark;
+}
+
+
+
+- (id)init {
+	self = [super init];
+	
+	_path			= [[WCTransferBenchmarkPath stringByStandardizingPath] retain];
+	_sizeFormatter	= [[WISizeFormatter alloc] init];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[_path release];
+	[_sizeFormatter release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (NSString *)recordTransfer:(WCTransfer *)transfer {
+	NSString						*direction, *scenarioName, *server;
+	_WCTransferBenchmarkScenario	scenario;
+	NSTimeInterval					time, CPUTime, timeToFirstByte;
+	WIFileOffset					bytes;
+	NSUInteger						files, index;
+	double							megabytesPerSecond, filesPerSecond, CPUPerGigabyte;
+	
+	index			= [transfer isKindOfClass:[WCDownloadTransfer class]] ? 0 : 1;
+	direction		= (index == 0) ? @"download" : @"upload";
+	files			= [transfer isFolder] ? [transfer numberOfTransferredFiles] : 1;
+	bytes			= [transfer actualTransferred];
+	time			= WIMax([transfer accumulatedTime], 0.001);
+	CPUTime			= [transfer CPUTime];
+	timeToFirstByte	= [transfer timeToFirstByte];
+	scenario		= [self _scenarioForTransfer:transfer files:files];
+	scenarioName	= [self _nameForScenario:scenario];
+	server			= [[[transfer connection] URL] hostpair];
+	
+	megabytesPerSecond	= ((double) bytes / 1048576.0) / time;
+	filesPerSecond		= (double) files / time;
+	CPUPerGigabyte		= (bytes > 0) ? CPUTime / ((double) bytes / 1073741824.0) : 0.0;
+	
+	_totals[index][scenario].runs++;
+	_totals[index][scenario].files		+= files;
+	_totals[index][scenario].bytes		+= bytes;
+	_totals[index][scenario].time		+= time;
+	_totals[index][scenario].CPUTime	+= CPUTime;
+	
+	[self _writeLine:[NSSWF:@"%@\t%@\t%@\t%@\t%@\t%lu\t%llu\t%.3f\t%.2f\t%.2f\t%.2f\t%.0f",
+		[[NSDate date] description],
+		direction,
+		scenarioName,
+		server ? server : @"",
+		[transfer name],
+		(unsigned long) files,
+		bytes,
+		time,
+		megabytesPerSecond,
+		filesPerSecond,
+		CPUPerGigabyte,
+		timeToFirstByte * 1000.0]];
+	
+	return [NSSWF:@"%@ %@ \"%@\": %lu files, %@ in %.1f s, %.2f MB/s, %.2f files/s, %.2f s CPU/GB, %.0f ms to first byte (%lu runs, %.2f MB/s average)",
+		scenarioName,
+		direction,
+		[transfer name],
+		(unsigned long) files,
+		[_sizeFormatter stringFromSize:bytes],
+		time,
+		megabytesPerSecond,
+		filesPerSecond,
+		CPUPerGigabyte,
+		timeToFirstByte * 1000.0,
+		(unsigned long) _totals[index][scenario].runs,
+		((double) _totals[index][scenario].bytes / 1048576.0) / _totals[index][scenario].time];
+}
+
+@end
@@ -32,6 +32,9 @@
 	WCTransfer							*_transfer;
 	WISocket							*_socket;
 	WIP7Socket							*_p7Socket;
+	
+	NSTimeInterval						_connectTime;
+	NSTimeInterval						_handshakeTime;
 }
 
 + (id)connectionWithTransfer:(WCTransfer *)transfer;
@@ -40,6 +43,8 @@
 - (BOOL)writeMessage:(WIP7Message *)message timeout:(NSTimeInterval)timeout error:(WIError **)error;
 - (WIP7Message *)readMessageWithTimeout:(NSTimeInterval)timeout error:(WIError **)error;
 
+- (void)setTransfer:(WCTransfer *)transfer;
 - (WCTransfer *)transfer;
+- (NSTimeInterval)handshakeTime;
 
 @end
@@ -27,6 +27,7 @@
  */
 
 #import "WCServerConnection.h"
+#import "WCStats.h"
 #import "WCTransfer.h"
 #import "WCTransferConnection.h"
 
@@ -74,6 +75,8 @@
 - (BOOL)connectWithTimeout:(NSTimeInterval)timeout error:(WCError **)error {
 	WIAddress		*address;
 	
+	_connectTime = [NSDate timeIntervalSinceReferenceDate];
+	
 	address = [WIAddress addressWithString:[[self URL] host] error:error];
 	
 	if(!address)
@@ -131,6 +134,12 @@
 		return NULL;
 	
 	if([_p7Socket verifyMessage:message error:error]) {
+		if(_handshakeTime == 0.0 && [[message name] isEqualToString:@"wired.account.privileges"]) {
+			_handshakeTime = [NSDate timeIntervalSinceReferenceDate] - _connectTime;
+			
+			[[WCStats stats] addHandshakeTime:_handshakeTime forServer:[[self URL] hostpair]];
+		}
+		
 		if([[message name] isEqualToString:@"wired.error"])
 			[[_transfer connection] postNotificationName:WCLinkConnectionReceivedErrorMessageNotification object:message];
 		else
@@ -150,12 +159,27 @@
 
 #pragma mark -
 
+- (void)setTransfer:(WCTransfer *)transfer {
+	[transfer retain];
+	[_transfer release];
+	
+	_transfer = transfer;
+}
+
+
+
 - (WCTransfer *)transfer {
 	return _transfer;
 }
 
 
 
+- (NSTimeInterval)handshakeTime {
+	return _handshakeTime;
+}
+
+
+
 - (WIP7Socket *)socket {
 	return _p7Socket;
 }
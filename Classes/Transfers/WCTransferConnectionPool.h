@@ -0,0 +1,61 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+@class WCServerConnection, WCTransfer, WCTransferConnection;
+
+@interface WCTransferConnectionPool : WIObject {
+	NSMutableArray						*_connections;
+	NSLock								*_lock;
+	int									_queue;
+	int									_pipe[2];
+	
+	NSTimeInterval						_idleTimeout;
+	BOOL								_reaping;
+	
+	NSUInteger							_hits;
+	NSUInteger							_misses;
+	NSTimeInterval						_handshakeTimeSaved;
+}
+
++ (NSTimeInterval)defaultIdleTimeout;
+
+- (id)initWithIdleTimeout:(NSTimeInterval)idleTimeout;
+
+- (void)setIdleTimeout:(NSTimeInterval)idleTimeout;
+- (NSTimeInterval)idleTimeout;
+
+- (WCTransferConnection *)connectionForTransfer:(WCTransfer *)transfer;
+- (BOOL)addConnection:(WCTransferConnection *)connection;
+- (void)removeConnectionsForConnection:(WCServerConnection *)connection;
+
+- (NSUInteger)numberOfIdleConnections;
+- (NSUInteger)hits;
+- (NSUInteger)misses;
+- (NSTimeInterval)handshakeTimeSaved;
+
+@end
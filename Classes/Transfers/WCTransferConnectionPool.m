@@ -0,0 +1,429 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/event.h>
+
+#import "WCServerConnection.h"
+#import "WCTime.h"
+#import "WCTransfer.h"
+#import "WCTransferConnection.h"
+#import "WCTransferConnectionPool.h"
+
+#define WCTransferConnectionPoolEvents			16
+
+@interface _WCTransferConnectionPoolEntry : NSObject {
+@public
+	WCTransferConnection					*connection;
+	WCServerConnection						*server;
+	NSTimeInterval							time;
+	int										descriptor;
+	BOOL									watched;
+}
+
+@end
+
+
+@implementation _WCTransferConnectionPoolEntry
+
+- (void)dealloc {
+	[connection release];
+	
+	[super dealloc];
+}
+
+@end
+
+
+
+@interface WCTransferConnectionPool(Private)
+
+- (BOOL)_serviceConnection:(WCTransferConnection *)connection;
+- (void)_unwatchEntry:(_WCTransferConnectionPoolEntry *)entry;
+
+@end
+
+
+@implementation WCTransferConnectionPool(Private)
+
+- (BOOL)_serviceConnection:(WCTransferConnection *)connection {
+	WIP7Message		*message, *reply;
+	WIError			*error;
+	WIP7UInt32		transaction;
+	
+	while([[[connection socket] socket] waitWithTimeout:0.0]) {
+		message = [connection readMessageWithTimeout:1.0 error:&error];
+		
+		if(!message)
+			return NO;
+		
+		if([[message name] isEqualToString:@"wired.send_ping"]) {
+			reply = [WIP7Message messageWithName:@"wired.ping" spec:WCP7Spec];
+			
+			if([message getUInt32:&transaction forName:@"wired.transaction"])
+				[reply setUInt32:transaction forName:@"wired.transaction"];
+			
+			if(![connection writeMessage:reply timeout:30.0 error:&error])
+				return NO;
+		}
+	}
+	
+	return YES;
+}
+
+
+
+- (void)_unwatchEntry:(_WCTransferConnectionPoolEntry *)entry {
+	struct kevent		event;
+	
+	if(entry->watched) {
+		EV_SET(&event, entry->descriptor, EVFILT_READ, EV_DELETE, 0, 0, NULL);
+		kevent(_queue, &event, 1, NULL, 0, NULL);
+		
+		entry->watched = NO;
+	}
+}
+
+@end
+
+
+
+@implementation WCTransferConnectionPool
+
++ (NSTimeInterval)defaultIdleTimeout {
+	return WIMax([[WCSettings settings] doubleForKey:WCTransferConnectionIdleTimeout], 0.0);
+}
+
+
+
+#pragma mark -
+
+- (id)initWithIdleTimeout:(NSTimeInterval)idleTimeout {
+	self = [super init];
+	
+	_idleTimeout	= idleTimeout;
+	_connections	= [[NSMutableArray alloc] init];
+	_lock			= [[NSLock alloc] init];
+	_queue			= kqueue();
+	
+	pipe(_pipe);
+	
+	fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL) | O_NONBLOCK);
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[_connections release];
+	[_lock release];
+	
+	close(_queue);
+	close(_pipe[0]);
+	close(_pipe[1]);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)reaperThread:(id)arg {
+	NSAutoreleasePool					*pool;
+	NSMutableArray						*connections;
+	_WCTransferConnectionPoolEntry		*entry;
+	struct kevent						event, events[WCTransferConnectionPoolEvents];
+	struct timespec						timeout;
+	NSTimeInterval						time, interval;
+	NSUInteger							i;
+	char								buffer[64];
+	int									j, count;
+	
+	EV_SET(&event, _pipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+	
+	while(YES) {
+		pool = [[NSAutoreleasePool alloc] init];
+		connections = [NSMutableArray array];
+		interval = -1.0;
+		
+		[_lock lock];
+		
+		time = WCTimeInterval();
+		
+		for(i = 0; i < [_connections count]; i++) {
+			entry = [_connections objectAtIndex:i];
+			
+			if(time - entry->time > _idleTimeout) {
+				[self _unwatchEntry:entry];
+				
+				[connections addObject:entry->connection];
+				[_connections removeObjectAtIndex:i];
+				
+				i--;
+				
+				continue;
+			}
+			
+			if(!entry->watched) {
+				EV_SET(&event, entry->descriptor, EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, NULL);
+				kevent(_queue, &event, 1, NULL, 0, NULL);
+				
+				entry->watched = YES;
+			}
+			
+			if(interval < 0.0 || entry->time + _idleTimeout - time < interval)
+				interval = entry->time + _idleTimeout - time;
+		}
+		
+		[_lock unlock];
+		
+		[connections makeObjectsPerformSelector:@selector(disconnect)];
+		
+		if(interval >= 0.0) {
+			timeout.tv_sec	= (time_t) interval + 1;
+			timeout.tv_nsec	= 0;
+		}
+		
+		count = kevent(_queue, NULL, 0, events, WCTransferConnectionPoolEvents, (interval >= 0.0) ? &timeout : NULL);
+		
+		for(j = 0; j < count; j++) {
+			if((int) events[j].ident == _pipe[0]) {
+				while(read(_pipe[0], buffer, sizeof(buffer)) > 0)
+					;
+				
+				continue;
+			}
+			
+			entry = NULL;
+			
+			[_lock lock];
+			
+			for(i = 0; i < [_connections count]; i++) {
+				if(((_WCTransferConnectionPoolEntry *) [_connections objectAtIndex:i])->descriptor == (int) events[j].ident) {
+					entry = [[[_connections objectAtIndex:i] retain] autorelease];
+					entry->watched = NO;
+					
+					[_connections removeObjectAtIndex:i];
+					
+					break;
+				}
+			}
+			
+			[_lock unlock];
+			
+			if(!entry)
+				continue;
+			
+			if([self _serviceConnection:entry->connection]) {
+				[_lock lock];
+				[_connections addObject:entry];
+				[_lock unlock];
+			} else {
+				[entry->connection disconnect];
+			}
+		}
+		
+		[pool release];
+	}
+}
+
+
+
+#pragma mark -
+
+- (void)setIdleTimeout:(NSTimeInterval)idleTimeout {
+	char		c = 0;
+	
+	[_lock lock];
+	_idleTimeout = idleTimeout;
+	[_lock unlock];
+	
+	write(_pipe[1], &c, 1);
+}
+
+
+
+- (NSTimeInterval)idleTimeout {
+	return _idleTimeout;
+}
+
+
+
+#pragma mark -
+
+- (WCTransferConnection *)connectionForTransfer:(WCTransfer *)transfer {
+	_WCTransferConnectionPoolEntry		*entry;
+	WCTransferConnection				*connection;
+	NSUInteger							i, count;
+	
+	connection = NULL;
+	
+	[_lock lock];
+	
+	count = [_connections count];
+	
+	for(i = 0; i < count; i++) {
+		entry = [_connections objectAtIndex:i];
+		
+		if(entry->server == [transfer connection]) {
+			[self _unwatchEntry:entry];
+			
+			connection = [[entry->connection retain] autorelease];
+			
+			[_connections removeObjectAtIndex:i];
+			
+			break;
+		}
+	}
+	
+	[_lock unlock];
+	
+	if(connection && [self _serviceConnection:connection]) {
+		[connection setTransfer:transfer];
+		
+		[_lock lock];
+		_hits++;
+		_handshakeTimeSaved += [connection handshakeTime];
+		[_lock unlock];
+	} else {
+		[connection disconnect];
+		
+		connection = NULL;
+		
+		[_lock lock];
+		_misses++;
+		[_lock unlock];
+	}
+	
+	return connection;
+}
+
+
+
+- (BOOL)addConnection:(WCTransferConnection *)connection {
+	_WCTransferConnectionPoolEntry		*entry;
+	WCServerConnection					*server;
+	char								c = 0;
+	
+	server = [[connection transfer] connection];
+	
+	if(_idleTimeout <= 0.0 || ![server isConnected])
+		return NO;
+	
+	entry = [[_WCTransferConnectionPoolEntry alloc] init];
+	entry->connection	= [connection retain];
+	entry->server		= server;
+	entry->time			= WCTimeInterval();
+	entry->descriptor	= wi_socket_descriptor([[[connection socket] socket] socket]);
+	
+	[connection setTransfer:NULL];
+	
+	[_lock lock];
+	
+	[_connections addObject:entry];
+	
+	if(!_reaping) {
+		_reaping = YES;
+		
+		[WIThread detachNewThreadSelector:@selector(reaperThread:) toTarget:self withObject:NULL];
+	}
+	
+	[_lock unlock];
+	
+	[entry release];
+	
+	write(_pipe[1], &c, 1);
+	
+	return YES;
+}
+
+
+
+- (void)removeConnectionsForConnection:(WCServerConnection *)connection {
+	NSMutableArray						*connections;
+	_WCTransferConnectionPoolEntry		*entry;
+	NSUInteger							i;
+	
+	connections = [NSMutableArray array];
+	
+	[_lock lock];
+	
+	for(i = 0; i < [_connections count]; i++) {
+		entry = [_connections objectAtIndex:i];
+		
+		if(entry->server == connection) {
+			[self _unwatchEntry:entry];
+			
+			[connections addObject:entry->connection];
+			[_connections removeObjectAtIndex:i];
+			
+			i--;
+		}
+	}
+	
+	[_lock unlock];
+	
+	[connections makeObjectsPerformSelector:@selector(disconnect)];
+}
+
+
+
+#pragma mark -
+
+- (NSUInteger)numberOfIdleConnections {
+	NSUInteger		count;
+	
+	[_lock lock];
+	count = [_connections count];
+	[_lock unlock];
+	
+	return count;
+}
+
+
+
+- (NSUInteger)hits {
+	return _hits;
+}
+
+
+
+- (NSUInteger)misses {
+	return _misses;
+}
+
+
+
+- (NSTimeInterval)handshakeTimeSaved {
+	return _handshakeTimeSaved;
+}
+
+@end
@@ -0,0 +1,231 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "WCFile.h"
+#import "WCTransferFileQueue.h"
+
+struct _WCTransferFileQueueNode {
+	WCFile								*file;
+	struct _WCTransferFileQueueNode		*previous;
+	struct _WCTransferFileQueueNode		*next;
+};
+typedef struct _WCTransferFileQueueNode	_WCTransferFileQueueNode;
+
+
+@interface WCTransferFileQueue(Private)
+
+- (_WCTransferFileQueueNode *)_nodeForFile:(WCFile *)file;
+
+@end
+
+
+@implementation WCTransferFileQueue(Private)
+
+- (_WCTransferFileQueueNode *)_nodeForFile:(WCFile *)file {
+	return (_WCTransferFileQueueNode *) CFDictionaryGetValue(_nodes, [file path]);
+}
+
+@end
+
+
+
+@implementation WCTransferFileQueue
+
++ (id)queue {
+	return [[[self alloc] init] autorelease];
+}
+
+
+
++ (id)queueWithArray:(NSArray *)array {
+	return [[[self alloc] initWithArray:array] autorelease];
+}
+
+
+
+- (id)init {
+	self = [super init];
+	
+	_nodes = CFDictionaryCreateMutable(NULL, 0, &kCFTypeDictionaryKeyCallBacks, NULL);
+	
+	return self;
+}
+
+
+
+- (id)initWithArray:(NSArray *)array {
+	NSEnumerator	*enumerator;
+	WCFile			*file;
+	
+	self = [self init];
+	
+	enumerator = [array objectEnumerator];
+	
+	while((file = [enumerator nextObject]))
+		[self addFile:file];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[self removeAllFiles];
+	
+	CFRelease(_nodes);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (NSUInteger)count {
+	return CFDictionaryGetCount(_nodes);
+}
+
+
+
+- (BOOL)containsFile:(WCFile *)file {
+	return ([self _nodeForFile:file] != NULL);
+}
+
+
+
+- (WCFile *)firstFile {
+	return _head ? _head->file : NULL;
+}
+
+
+
+- (WCFile *)fileAfterFile:(WCFile *)file {
+	_WCTransferFileQueueNode	*node;
+	
+	node = [self _nodeForFile:file];
+	
+	return (node && node->next) ? node->next->file : NULL;
+}
+
+
+
+- (NSArray *)files {
+	NSMutableArray				*files;
+	_WCTransferFileQueueNode	*node;
+	
+	files = [NSMutableArray arrayWithCapacity:[self count]];
+	
+	for(node = _head; node; node = node->next)
+		[files addObject:node->file];
+	
+	return files;
+}
+
+
+
+#pragma mark -
+
+- (void)addFile:(WCFile *)file {
+	_WCTransferFileQueueNode	*node;
+	NSString					*path;
+	
+	if([self _nodeForFile:file])
+		return;
+	
+	node = malloc(sizeof(_WCTransferFileQueueNode));
+	node->file		= [file retain];
+	node->previous	= _tail;
+	node->next		= NULL;
+	
+	if(_tail)
+		_tail->next = node;
+	else
+		_head = node;
+	
+	_tail = node;
+	
+	path = [[file path] copy];
+	CFDictionarySetValue(_nodes, path, node);
+	[path release];
+}
+
+
+
+- (void)removeFile:(WCFile *)file {
+	_WCTransferFileQueueNode	*node;
+	
+	node = [self _nodeForFile:file];
+	
+	if(!node)
+		return;
+	
+	CFDictionaryRemoveValue(_nodes, [file path]);
+	
+	if(node->previous)
+		node->previous->next = node->next;
+	else
+		_head = node->next;
+	
+	if(node->next)
+		node->next->previous = node->previous;
+	else
+		_tail = node->previous;
+	
+	[node->file release];
+	free(node);
+}
+
+
+
+- (void)removeAllFiles {
+	_WCTransferFileQueueNode	*node, *next;
+	
+	for(node = _head; node; node = next) {
+		next = node->next;
+		
+		[node->file release];
+		free(node);
+	}
+	
+	_head = _tail = NULL;
+	
+	CFDictionaryRemoveAllValues(_nodes);
+}
+
+
+
+#pragma mark -
+
+- (void)makeFilesPerformSelector:(SEL)selector withObject:(id)object {
+	_WCTransferFileQueueNode	*node;
+	
+	for(node = _head; node; node = node->next)
+		[node->file performSelector:selector withObject:object];
+}
+
+@end
@@ -0,0 +1,579 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "WCTransfer.h"
+#import "WCTransferJournal.h"
+
+#define _WCTransferJournalMagic						0x5743544A
+#define _WCTransferJournalVersion					1
+#define _WCTransferJournalHeaderSize				8
+#define _WCTransferJournalMinimumCompactionSize		1048576
+
+enum _WCTransferJournalRecordType {
+	_WCTransferJournalPut							= 1,
+	_WCTransferJournalRemove,
+	_WCTransferJournalOrder
+};
+typedef enum _WCTransferJournalRecordType			_WCTransferJournalRecordType;
+
+
+static BOOL _WCTransferJournalWrite(int fd, const void *bytes, size_t length) {
+	ssize_t		bytesWritten;
+	
+	while(length > 0) {
+		bytesWritten = write(fd, bytes, length);
+		
+		if(bytesWritten < 0) {
+			if(errno == EINTR)
+				continue;
+			
+			return NO;
+		}
+		
+		bytes = (const char *) bytes + bytesWritten;
+		length -= bytesWritten;
+	}
+	
+	return YES;
+}
+
+
+
+static BOOL _WCTransferJournalWriteHeader(int fd) {
+	uint32_t	header[2];
+	
+	header[0] = NSSwapHostIntToBig(_WCTransferJournalMagic);
+	header[1] = NSSwapHostIntToBig(_WCTransferJournalVersion);
+	
+	return _WCTransferJournalWrite(fd, header, sizeof(header));
+}
+
+
+
+@interface WCTransferJournal(Private)
+
+- (BOOL)_openForAppending;
+- (NSData *)_recordWithType:(_WCTransferJournalRecordType)type identifier:(NSString *)identifier data:(NSData *)data;
+- (BOOL)_appendRecordWithType:(_WCTransferJournalRecordType)type identifier:(NSString *)identifier data:(NSData *)data range:(NSRange *)range;
+- (NSData *)_archiveInRecord:(NSData *)record;
+
+- (void)_compactIfNeeded;
+- (BOOL)_compact;
+- (BOOL)_replaceWithRecords:(NSArray *)records identifiers:(NSArray *)identifiers;
+
+@end
+
+
+@implementation WCTransferJournal(Private)
+
+- (BOOL)_openForAppending {
+	struct stat		sb;
+	
+	_fd = open([_path fileSystemRepresentation], O_WRONLY | O_APPEND | O_CREAT, 0644);
+	
+	if(_fd < 0)
+		return NO;
+	
+	if(fstat(_fd, &sb) < 0) {
+		close(_fd);
+		_fd = -1;
+		
+		return NO;
+	}
+	
+	if(sb.st_size < _WCTransferJournalHeaderSize) {
+		if(ftruncate(_fd, 0) < 0 || !_WCTransferJournalWriteHeader(_fd)) {
+			close(_fd);
+			_fd = -1;
+			
+			return NO;
+		}
+		
+		_size = _WCTransferJournalHeaderSize;
+	} else {
+		_size = sb.st_size;
+	}
+	
+	return YES;
+}
+
+
+
+- (NSData *)_recordWithType:(_WCTransferJournalRecordType)type identifier:(NSString *)identifier data:(NSData *)data {
+	NSMutableData		*record;
+	NSData				*identifierData;
+	uint32_t			length;
+	uint16_t			identifierLength;
+	uint8_t				recordType;
+	
+	identifierData		= [identifier dataUsingEncoding:NSUTF8StringEncoding];
+	length				= NSSwapHostIntToBig(sizeof(recordType) + sizeof(identifierLength) + [identifierData length] + [data length]);
+	identifierLength	= NSSwapHostShortToBig([identifierData length]);
+	recordType			= type;
+	record				= [NSMutableData dataWithCapacity:sizeof(length) + NSSwapBigIntToHost(length)];
+	
+	[record appendBytes:&length length:sizeof(length)];
+	[record appendBytes:&recordType length:sizeof(recordType)];
+	[record appendBytes:&identifierLength length:sizeof(identifierLength)];
+	[record appendData:identifierData];
+	[record appendData:data];
+	
+	return record;
+}
+
+
+
+- (BOOL)_appendRecordWithType:(_WCTransferJournalRecordType)type identifier:(NSString *)identifier data:(NSData *)data range:(NSRange *)range {
+	NSData		*record;
+	
+	if(_fd < 0 && ![self _openForAppending])
+		return NO;
+	
+	record = [self _recordWithType:type identifier:identifier data:data];
+	
+	if(!_WCTransferJournalWrite(_fd, [record bytes], [record length])) {
+		ftruncate(_fd, _size);
+		
+		return NO;
+	}
+	
+	if(range)
+		*range = NSMakeRange(_size, [record length]);
+	
+	_size += [record length];
+	
+	return YES;
+}
+
+
+
+- (NSData *)_archiveInRecord:(NSData *)record {
+	const unsigned char		*bytes;
+	uint16_t				identifierLength;
+	NSUInteger				offset;
+	
+	bytes = [record bytes];
+	
+	memcpy(&identifierLength, bytes + 5, sizeof(identifierLength));
+	
+	offset = 7 + NSSwapBigShortToHost(identifierLength);
+	
+	if(offset > [record length])
+		return NULL;
+	
+	return [record subdataWithRange:NSMakeRange(offset, [record length] - offset)];
+}
+
+
+
+#pragma mark -
+
+- (void)_compactIfNeeded {
+	if(_size > _WCTransferJournalMinimumCompactionSize && _size > 2 * (_liveSize + _WCTransferJournalHeaderSize))
+		[self _compact];
+}
+
+
+
+- (BOOL)_compact {
+	NSMutableArray		*records;
+	NSMutableData		*record;
+	NSEnumerator		*enumerator;
+	NSString			*identifier;
+	NSRange				range;
+	int					fd;
+	
+	fd = open([_path fileSystemRepresentation], O_RDONLY);
+	
+	if(fd < 0)
+		return NO;
+	
+	records = [NSMutableArray arrayWithCapacity:[_identifiers count]];
+	enumerator = [_identifiers objectEnumerator];
+	
+	while((identifier = [enumerator nextObject])) {
+		range = [[_records objectForKey:identifier] rangeValue];
+		record = [NSMutableData dataWithLength:range.length];
+		
+		if(pread(fd, [record mutableBytes], range.length, range.location) != (ssize_t) range.length) {
+			close(fd);
+			
+			return NO;
+		}
+		
+		[records addObject:record];
+	}
+	
+	close(fd);
+	
+	return [self _replaceWithRecords:records identifiers:[[_identifiers copy] autorelease]];
+}
+
+
+
+- (BOOL)_replaceWithRecords:(NSArray *)records identifiers:(NSArray *)identifiers {
+	NSMutableDictionary		*ranges;
+	NSString				*temporaryPath;
+	NSData					*record;
+	NSUInteger				i, count;
+	size_t					offset;
+	int						fd;
+	
+	temporaryPath = [_path stringByAppendingPathExtension:@"tmp"];
+	fd = open([temporaryPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	
+	if(fd < 0)
+		return NO;
+	
+	if(!_WCTransferJournalWriteHeader(fd)) {
+		close(fd);
+		unlink([temporaryPath fileSystemRepresentation]);
+		
+		return NO;
+	}
+	
+	ranges = [NSMutableDictionary dictionaryWithCapacity:[records count]];
+	offset = _WCTransferJournalHeaderSize;
+	count = [records count];
+	
+	for(i = 0; i < count; i++) {
+		record = [records objectAtIndex:i];
+		
+		if(!_WCTransferJournalWrite(fd, [record bytes], [record length])) {
+			close(fd);
+			unlink([temporaryPath fileSystemRepresentation]);
+			
+			return NO;
+		}
+		
+		[ranges setObject:[NSValue valueWithRange:NSMakeRange(offset, [record length])]
+				   forKey:[identifiers objectAtIndex:i]];
+		
+		offset += [record length];
+	}
+	
+	fsync(fd);
+	close(fd);
+	
+	if(rename([temporaryPath fileSystemRepresentation], [_path fileSystemRepresentation]) < 0) {
+		unlink([temporaryPath fileSystemRepresentation]);
+		
+		return NO;
+	}
+	
+	if(_fd >= 0)
+		close(_fd);
+	
+	_fd			= -1;
+	_size		= offset;
+	_liveSize	= offset - _WCTransferJournalHeaderSize;
+	
+	[_records setDictionary:ranges];
+	[_identifiers setArray:identifiers];
+	
+	return [self _openForAppending];
+}
+
+@end
+
+
+
+@implementation WCTransferJournal
+
+- (id)initWithPath:(NSString *)path {
+	self = [super init];
+	
+	_path			= [path retain];
+	_identifiers	= [[NSMutableArray alloc] init];
+	_records		= [[NSMutableDictionary alloc] init];
+	_fd				= -1;
+	
+	[[NSFileManager defaultManager] createDirectoryAtPath:[_path stringByDeletingLastPathComponent]];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	if(_fd >= 0)
+		close(_fd);
+	
+	[_path release];
+	[_identifiers release];
+	[_records release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (NSMutableArray *)readTransfers {
+	NSMutableArray			*transfers, *identifiers;
+	NSEnumerator			*enumerator;
+	NSString				*identifier;
+	NSData					*data, *archive;
+	NSValue					*value;
+	WCTransfer				*transfer;
+	const unsigned char		*bytes;
+	NSRange					range;
+	NSUInteger				offset, length;
+	uint32_t				header[2], recordLength;
+	uint16_t				identifierLength;
+	uint8_t					type;
+	
+	[_identifiers removeAllObjects];
+	[_records removeAllObjects];
+	
+	_size		= 0;
+	_liveSize	= 0;
+	
+	data		= [NSData dataWithContentsOfMappedFile:_path];
+	bytes		= [data bytes];
+	length		= [data length];
+	offset		= 0;
+	
+	if(length >= _WCTransferJournalHeaderSize) {
+		memcpy(header, bytes, sizeof(header));
+		
+		if(NSSwapBigIntToHost(header[0]) == _WCTransferJournalMagic &&
+		   NSSwapBigIntToHost(header[1]) == _WCTransferJournalVersion)
+			offset = _WCTransferJournalHeaderSize;
+	}
+	
+	while(offset > 0 && offset + sizeof(recordLength) <= length) {
+		memcpy(&recordLength, bytes + offset, sizeof(recordLength));
+		
+		recordLength = NSSwapBigIntToHost(recordLength);
+		
+		if(recordLength < sizeof(type) + sizeof(identifierLength) || offset + sizeof(recordLength) + recordLength > length)
+			break;
+		
+		type = bytes[offset + 4];
+		
+		memcpy(&identifierLength, bytes + offset + 5, sizeof(identifierLength));
+		
+		identifierLength = NSSwapBigShortToHost(identifierLength);
+		
+		if(sizeof(type) + sizeof(identifierLength) + identifierLength > recordLength)
+			break;
+		
+		identifier = [[[NSString alloc] initWithBytes:bytes + offset + 7
+											   length:identifierLength
+											 encoding:NSUTF8StringEncoding] autorelease];
+		range = NSMakeRange(offset, sizeof(recordLength) + recordLength);
+		value = [_records objectForKey:identifier];
+		
+		switch(type) {
+			case _WCTransferJournalPut:
+				if(value)
+					_liveSize -= [value rangeValue].length;
+				else
+					[_identifiers addObject:identifier];
+				
+				[_records setObject:[NSValue valueWithRange:range] forKey:identifier];
+				
+				_liveSize += range.length;
+				break;
+			
+			case _WCTransferJournalRemove:
+				if(value) {
+					_liveSize -= [value rangeValue].length;
+					
+					[_records removeObjectForKey:identifier];
+					[_identifiers removeObject:identifier];
+				}
+				break;
+			
+			case _WCTransferJournalOrder:
+				archive = [data subdataWithRange:NSMakeRange(offset + 7 + identifierLength, recordLength - 3 - identifierLength)];
+				identifiers = [NSMutableArray array];
+				enumerator = [[[NSString stringWithData:archive encoding:NSUTF8StringEncoding]
+					componentsSeparatedByString:@"\n"] objectEnumerator];
+				
+				while((identifier = [enumerator nextObject])) {
+					if([_records objectForKey:identifier] && ![identifiers containsObject:identifier])
+						[identifiers addObject:identifier];
+				}
+				
+				enumerator = [_identifiers objectEnumerator];
+				
+				while((identifier = [enumerator nextObject])) {
+					if(![identifiers containsObject:identifier])
+						[identifiers addObject:identifier];
+				}
+				
+				[_identifiers setArray:identifiers];
+				break;
+		}
+		
+		offset += range.length;
+	}
+	
+	if(offset < length)
+		truncate([_path fileSystemRepresentation], offset);
+	
+	transfers = [NSMutableArray arrayWithCapacity:[_identifiers count]];
+	enumerator = [_identifiers objectEnumerator];
+	
+	while((identifier = [enumerator nextObject])) {
+		archive = [self _archiveInRecord:[data subdataWithRange:[[_records objectForKey:identifier] rangeValue]]];
+		transfer = archive ? [NSKeyedUnarchiver unarchiveObjectWithData:archive] : NULL;
+		
+		if(transfer && [transfer isKindOfClass:[WCTransfer class]])
+			[transfers addObject:transfer];
+	}
+	
+	if(_fd >= 0) {
+		close(_fd);
+		
+		_fd = -1;
+	}
+	
+	if([self _openForAppending])
+		[self _compactIfNeeded];
+	
+	return transfers;
+}
+
+
+
+- (void)writeTransfer:(WCTransfer *)transfer {
+	NSString		*identifier;
+	NSValue			*value;
+	NSRange			range;
+	
+	identifier = [transfer identifier];
+	
+	if(![self _appendRecordWithType:_WCTransferJournalPut
+						 identifier:identifier
+							   data:[NSKeyedArchiver archivedDataWithRootObject:transfer]
+							  range:&range])
+		return;
+	
+	value = [_records objectForKey:identifier];
+	
+	if(value)
+		_liveSize -= [value rangeValue].length;
+	else
+		[_identifiers addObject:identifier];
+	
+	[_records setObject:[NSValue valueWithRange:range] forKey:identifier];
+	
+	_liveSize += range.length;
+	
+	[self _compactIfNeeded];
+}
+
+
+
+- (void)removeTransfer:(WCTransfer *)transfer {
+	NSString		*identifier;
+	NSValue			*value;
+	
+	identifier = [transfer identifier];
+	value = [_records objectForKey:identifier];
+	
+	if(!value)
+		return;
+	
+	if(![self _appendRecordWithType:_WCTransferJournalRemove identifier:identifier data:[NSData data] range:NULL])
+		return;
+	
+	_liveSize -= [value rangeValue].length;
+	
+	[_records removeObjectForKey:identifier];
+	[_identifiers removeObject:identifier];
+	
+	[self _compactIfNeeded];
+}
+
+
+
+- (void)writeOrderOfTransfers:(NSArray *)transfers {
+	NSEnumerator		*enumerator;
+	NSMutableArray		*identifiers;
+	NSString			*identifier;
+	WCTransfer			*transfer;
+	
+	identifiers = [NSMutableArray arrayWithCapacity:[_identifiers count]];
+	enumerator = [transfers objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		if([_records objectForKey:[transfer identifier]])
+			[identifiers addObject:[transfer identifier]];
+	}
+	
+	enumerator = [_identifiers objectEnumerator];
+	
+	while((identifier = [enumerator nextObject])) {
+		if(![identifiers containsObject:identifier])
+			[identifiers addObject:identifier];
+	}
+	
+	if([identifiers isEqualToArray:_identifiers])
+		return;
+	
+	if(![self _appendRecordWithType:_WCTransferJournalOrder
+						 identifier:@""
+							   data:[[identifiers componentsJoinedByString:@"\n"] dataUsingEncoding:NSUTF8StringEncoding]
+							  range:NULL])
+		return;
+	
+	[_identifiers setArray:identifiers];
+	
+	[self _compactIfNeeded];
+}
+
+
+
+- (void)compactWithTransfers:(NSArray *)transfers {
+	NSEnumerator		*enumerator;
+	NSMutableArray		*records, *identifiers;
+	WCTransfer			*transfer;
+	
+	records = [NSMutableArray arrayWithCapacity:[transfers count]];
+	identifiers = [NSMutableArray arrayWithCapacity:[transfers count]];
+	enumerator = [transfers objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		if([identifiers containsObject:[transfer identifier]])
+			continue;
+		
+		[records addObject:[self _recordWithType:_WCTransferJournalPut
+									  identifier:[transfer identifier]
+											data:[NSKeyedArchiver archivedDataWithRootObject:transfer]]];
+		[identifiers addObject:[transfer identifier]];
+	}
+	
+	[self _replaceWithRecords:records identifiers:identifiers];
+}
+
+@end
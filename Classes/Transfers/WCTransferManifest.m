@@ -0,0 +1,342 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#import "WCTransferManifest.h"
+
+#define WCTransferManifestExtendedAttributeName		@"com.zankasoftware.WiredTransfer.Manifest"
+
+#define _WCTransferManifestMagic					0x5743544D
+#define _WCTransferManifestVersion					1
+#define _WCTransferManifestHeaderSize				20
+#define _WCTransferManifestDigestLength				8
+#define _WCTransferManifestMinimumChunkSize			4194304
+#define _WCTransferManifestMaximumChunkSize			1073741824
+#define _WCTransferManifestMaximumDigests			256
+#define _WCTransferManifestReadBufferSize			262144
+
+
+static BOOL _WCTransferManifestHashFile(int fd, WIFileOffset offset, NSUInteger length, SHA_CTX *context) {
+	char		*buffer;
+	ssize_t		bytesRead;
+	
+	buffer = malloc(_WCTransferManifestReadBufferSize);
+	
+	while(length > 0) {
+		bytesRead = pread(fd, buffer, WIMin(length, _WCTransferManifestReadBufferSize), offset);
+		
+		if(bytesRead < 0 && errno == EINTR)
+			continue;
+		
+		if(bytesRead <= 0)
+			break;
+		
+		SHA1_Update(context, buffer, bytesRead);
+		
+		offset += bytesRead;
+		length -= bytesRead;
+	}
+	
+	free(buffer);
+	
+	return (length == 0);
+}
+
+
+
+static void _WCTransferManifestDigest(SHA_CTX *context, unsigned char *digest) {
+	SHA_CTX				copy;
+	unsigned char		md[SHA_DIGEST_LENGTH];
+	
+	copy = *context;
+	
+	SHA1_Final(md, &copy);
+	
+	memcpy(digest, md, _WCTransferManifestDigestLength);
+}
+
+
+
+@interface WCTransferManifest(Private)
+
+- (id)_initWithPath:(NSString *)path data:(NSData *)data;
+
+- (void)_resetToChunk:(NSUInteger)chunk;
+
+@end
+
+
+@implementation WCTransferManifest(Private)
+
+- (id)_initWithPath:(NSString *)path data:(NSData *)data {
+	const unsigned char		*bytes;
+	uint32_t				header[3];
+	uint64_t				length;
+	NSUInteger				chunks;
+	
+	self = [super init];
+	
+	if([data length] < _WCTransferManifestHeaderSize) {
+		[self release];
+		
+		return NULL;
+	}
+	
+	bytes = [data bytes];
+	
+	memcpy(header, bytes, sizeof(header));
+	memcpy(&length, bytes + sizeof(header), sizeof(length));
+	
+	_chunkSize	= NSSwapBigIntToHost(header[2]);
+	_length		= NSSwapBigLongLongToHost(length);
+	
+	if(NSSwapBigIntToHost(header[0]) != _WCTransferManifestMagic ||
+	   NSSwapBigIntToHost(header[1]) != _WCTransferManifestVersion ||
+	   _chunkSize == 0) {
+		[self release];
+		
+		return NULL;
+	}
+	
+	chunks = _length / _chunkSize;
+	
+	if([data length] != _WCTransferManifestHeaderSize + ((chunks + (_length % _chunkSize > 0 ? 1 : 0)) * _WCTransferManifestDigestLength)) {
+		[self release];
+		
+		return NULL;
+	}
+	
+	_path		= [path retain];
+	_digests	= [[NSMutableData alloc] initWithBytes:bytes + _WCTransferManifestHeaderSize
+												length:chunks * _WCTransferManifestDigestLength];
+	
+	if(_length % _chunkSize > 0) {
+		memcpy(_tailDigest,
+			   bytes + _WCTransferManifestHeaderSize + (chunks * _WCTransferManifestDigestLength),
+			   _WCTransferManifestDigestLength);
+	}
+	
+	SHA1_Init(&_context);
+	
+	return self;
+}
+
+
+
+#pragma mark -
+
+- (void)_resetToChunk:(NSUInteger)chunk {
+	[_digests setLength:chunk * _WCTransferManifestDigestLength];
+	
+	_length = (WIFileOffset) chunk * _chunkSize;
+	
+	SHA1_Init(&_context);
+}
+
+@end
+
+
+
+@implementation WCTransferManifest
+
++ (id)manifestWithContentsOfPath:(NSString *)path {
+	NSData		*data;
+	
+	data = [[NSFileManager defaultManager] extendedAttributeForName:WCTransferManifestExtendedAttributeName atPath:path error:NULL];
+	
+	if(!data)
+		return NULL;
+	
+	return [[[self alloc] _initWithPath:path data:data] autorelease];
+}
+
+
+
++ (void)removeManifestAtPath:(NSString *)path {
+	[[NSFileManager defaultManager] removeExtendedAttributeForName:WCTransferManifestExtendedAttributeName atPath:path error:NULL];
+}
+
+
+
+#pragma mark -
+
+- (id)initWithPath:(NSString *)path dataSize:(WIFileOffset)dataSize {
+	self = [super init];
+	
+	_path		= [path retain];
+	_chunkSize	= _WCTransferManifestMinimumChunkSize;
+	_digests	= [[NSMutableData alloc] init];
+	
+	while(_chunkSize < _WCTransferManifestMaximumChunkSize && (WIFileOffset) _chunkSize * _WCTransferManifestMaximumDigests < dataSize)
+		_chunkSize *= 2;
+	
+	SHA1_Init(&_context);
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[_path release];
+	[_digests release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (WIFileOffset)verifyLength:(WIFileOffset)length {
+	const unsigned char		*digests;
+	struct stat				sb;
+	SHA_CTX					context;
+	unsigned char			digest[_WCTransferManifestDigestLength];
+	WIFileOffset			offset;
+	NSUInteger				chunk;
+	int						fd;
+	
+	fd = open([_path fileSystemRepresentation], O_RDONLY);
+	
+	if(fd < 0 || fstat(fd, &sb) < 0) {
+		if(fd >= 0)
+			close(fd);
+		
+		[self _resetToChunk:0];
+		
+		return 0;
+	}
+	
+	length = WIMin(length, (WIFileOffset) sb.st_size);
+	
+	if(_length % _chunkSize > 0 && length >= _length) {
+		offset = _length - (_length % _chunkSize);
+		
+		SHA1_Init(&context);
+		
+		if(_WCTransferManifestHashFile(fd, offset, _length - offset, &context)) {
+			_WCTransferManifestDigest(&context, digest);
+			
+			if(memcmp(digest, _tailDigest, sizeof(digest)) == 0) {
+				_context = context;
+				
+				close(fd);
+				
+				return _length;
+			}
+		}
+	}
+	
+	digests	= [_digests bytes];
+	chunk	= WIMin(length, _length) / _chunkSize;
+	
+	while(chunk > 0) {
+		SHA1_Init(&context);
+		
+		if(_WCTransferManifestHashFile(fd, (WIFileOffset) (chunk - 1) * _chunkSize, _chunkSize, &context)) {
+			_WCTransferManifestDigest(&context, digest);
+			
+			if(memcmp(digest, digests + ((chunk - 1) * _WCTransferManifestDigestLength), sizeof(digest)) == 0)
+				break;
+		}
+		
+		chunk--;
+	}
+	
+	close(fd);
+	
+	[self _resetToChunk:chunk];
+	
+	return _length;
+}
+
+
+
+- (void)updateWithBytes:(const void *)bytes length:(NSUInteger)length {
+	unsigned char		digest[_WCTransferManifestDigestLength];
+	NSUInteger			bytesToHash;
+	
+	while(length > 0) {
+		bytesToHash = WIMin(length, _chunkSize - (NSUInteger) (_length % _chunkSize));
+		
+		SHA1_Update(&_context, bytes, bytesToHash);
+		
+		_length		+= bytesToHash;
+		bytes		= (const char *) bytes + bytesToHash;
+		length		-= bytesToHash;
+		
+		if(_length % _chunkSize == 0) {
+			_WCTransferManifestDigest(&_context, digest);
+			
+			[_digests appendBytes:digest length:sizeof(digest)];
+			
+			SHA1_Init(&_context);
+			
+			[self write];
+		}
+	}
+}
+
+
+
+- (BOOL)write {
+	NSMutableData		*data;
+	uint32_t			header[3];
+	uint64_t			length;
+	unsigned char		digest[_WCTransferManifestDigestLength];
+	
+	header[0]	= NSSwapHostIntToBig(_WCTransferManifestMagic);
+	header[1]	= NSSwapHostIntToBig(_WCTransferManifestVersion);
+	header[2]	= NSSwapHostIntToBig(_chunkSize);
+	length		= NSSwapHostLongLongToBig(_length);
+	data		= [NSMutableData dataWithCapacity:_WCTransferManifestHeaderSize + [_digests length] + sizeof(digest)];
+	
+	[data appendBytes:header length:sizeof(header)];
+	[data appendBytes:&length length:sizeof(length)];
+	[data appendData:_digests];
+	
+	if(_length % _chunkSize > 0) {
+		_WCTransferManifestDigest(&_context, digest);
+		
+		[data appendBytes:digest length:sizeof(digest)];
+	}
+	
+	return [[NSFileManager defaultManager] setExtendedAttribute:data
+														forName:WCTransferManifestExtendedAttributeName
+														 atPath:_path
+														  error:NULL];
+}
+
+
+
+#pragma mark -
+
+- (WIFileOffset)length {
+	return _length;
+}
+
+@end
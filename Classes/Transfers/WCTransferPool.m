@@ -0,0 +1,435 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <sys/event.h>
+
+#import "WCTransfer.h"
+#import "WCTransferPool.h"
+
+#define WCTransferPoolIdleInterval			60.0
+#define WCTransferPoolCheckInterval			1
+#define WCTransferPoolEvents				64
+
+enum _WCTransferPoolCondition {
+	_WCTransferPoolNoJobs,
+	_WCTransferPoolHasJobs
+};
+
+
+@interface _WCTransferPoolJob : NSObject {
+@public
+	id										target;
+	SEL										selector;
+	WCTransfer								*transfer;
+	id										object;
+	WISocket								*socket;
+}
+
+@end
+
+
+@implementation _WCTransferPoolJob
+
+- (void)dealloc {
+	[target release];
+	[transfer release];
+	[object release];
+	[socket release];
+	
+	[super dealloc];
+}
+
+@end
+
+
+
+@interface WCTransferPool(Private)
+
+- (void)_addJob:(_WCTransferPoolJob *)job;
+- (void)_unparkJob:(_WCTransferPoolJob *)job watchedJobs:(NSMutableSet *)watchedJobs;
+
+@end
+
+
+@implementation WCTransferPool(Private)
+
+- (void)_addJob:(_WCTransferPoolJob *)job {
+	[_jobsLock lock];
+	
+	[_jobs addObject:job];
+	
+	if(_workers - _busyWorkers < [_jobs count] && _workers < _size) {
+		_workers++;
+		
+		[WIThread detachNewThreadSelector:@selector(workerThread:) toTarget:self withObject:NULL];
+	}
+	
+	[_jobsLock unlockWithCondition:_WCTransferPoolHasJobs];
+}
+
+
+
+- (void)_unparkJob:(_WCTransferPoolJob *)job watchedJobs:(NSMutableSet *)watchedJobs {
+	[job retain];
+	
+	[_parkedJobsLock lock];
+	[_parkedJobs removeObject:job];
+	[_parkedJobsLock unlockWithCondition:([_parkedJobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+	
+	[watchedJobs removeObject:job];
+	
+	[self _addJob:job];
+	
+	[job release];
+}
+
+@end
+
+
+
+@implementation WCTransferPool
+
++ (NSUInteger)defaultSize {
+	return WIMax([[WCSettings settings] integerForKey:WCTransferWorkers], 1);
+}
+
+
+
+#pragma mark -
+
+- (id)initWithSize:(NSUInteger)size {
+	self = [super init];
+	
+	_size				= size;
+	_jobs				= [[NSMutableArray alloc] init];
+	_parkedJobs			= [[NSMutableArray alloc] init];
+	_jobsLock			= [[NSConditionLock alloc] initWithCondition:_WCTransferPoolNoJobs];
+	_parkedJobsLock		= [[NSConditionLock alloc] initWithCondition:_WCTransferPoolNoJobs];
+	_queue				= kqueue();
+	
+	pipe(_pipe);
+	
+	fcntl(_pipe[0], F_SETFL, fcntl(_pipe[0], F_GETFL) | O_NONBLOCK);
+	fcntl(_pipe[1], F_SETFL, fcntl(_pipe[1], F_GETFL) | O_NONBLOCK);
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[_jobs release];
+	[_parkedJobs release];
+	[_jobsLock release];
+	[_parkedJobsLock release];
+	
+	close(_queue);
+	close(_pipe[0]);
+	close(_pipe[1]);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)workerThread:(id)arg {
+	NSAutoreleasePool		*pool;
+	NSDate					*date;
+	_WCTransferPoolJob		*job;
+	BOOL					locked, exit;
+	
+	do {
+		date = [[NSDate alloc] initWithTimeIntervalSinceNow:WCTransferPoolIdleInterval];
+		locked = [_jobsLock lockWhenCondition:_WCTransferPoolHasJobs beforeDate:date];
+		[date release];
+		
+		if(!locked) {
+			[_jobsLock lock];
+			
+			exit = ([_jobs count] == 0);
+			
+			if(exit)
+				_workers--;
+			
+			[_jobsLock unlockWithCondition:([_jobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+			
+			continue;
+		}
+		
+		job = [[_jobs objectAtIndex:0] retain];
+		
+		[_jobs removeObjectAtIndex:0];
+		
+		_busyWorkers++;
+		
+		[_jobsLock unlockWithCondition:([_jobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+		
+		pool = [[NSAutoreleasePool alloc] init];
+		
+		if(job->object)
+			[job->target performSelector:job->selector withObject:job->transfer withObject:job->object];
+		else
+			[job->target performSelector:job->selector withObject:job->transfer];
+		
+		[pool release];
+		
+		[job release];
+		
+		[_jobsLock lock];
+		
+		_busyWorkers--;
+		
+		exit = (_workers > _size);
+		
+		if(exit)
+			_workers--;
+		
+		[_jobsLock unlockWithCondition:([_jobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+	} while(!exit);
+}
+
+
+
+- (void)monitorThread:(id)arg {
+	NSAutoreleasePool		*pool;
+	NSMutableSet			*watchedJobs;
+	NSEnumerator			*enumerator;
+	NSArray					*jobs;
+	_WCTransferPoolJob		*job;
+	struct kevent			event, events[WCTransferPoolEvents];
+	struct timespec			timeout;
+	char					buffer[64];
+	NSUInteger				i, count;
+	int						eventCount;
+	
+	watchedJobs = [[NSMutableSet alloc] init];
+	
+	EV_SET(&event, _pipe[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
+	kevent(_queue, &event, 1, NULL, 0, NULL);
+	
+	timeout.tv_sec		= WCTransferPoolCheckInterval;
+	timeout.tv_nsec		= 0;
+	
+	while(YES) {
+		pool = [[NSAutoreleasePool alloc] init];
+		
+		[_parkedJobsLock lock];
+		jobs = [[_parkedJobs copy] autorelease];
+		[_parkedJobsLock unlockWithCondition:([jobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+		
+		count = [jobs count];
+		
+		for(i = 0; i < count; i++) {
+			job = [jobs objectAtIndex:i];
+			
+			if(![watchedJobs containsObject:job]) {
+				EV_SET(&event, wi_socket_descriptor([job->socket socket]), EVFILT_READ, EV_ADD | EV_ONESHOT, 0, 0, job);
+				kevent(_queue, &event, 1, NULL, 0, NULL);
+				
+				[watchedJobs addObject:job];
+			}
+		}
+		
+		eventCount = kevent(_queue, NULL, 0, events, WCTransferPoolEvents, ([watchedJobs count] > 0) ? &timeout : NULL);
+		
+		for(i = 0; (int) i < eventCount; i++) {
+			if((int) events[i].ident == _pipe[0]) {
+				while(read(_pipe[0], buffer, sizeof(buffer)) > 0)
+					;
+				
+				continue;
+			}
+			
+			[self _unparkJob:events[i].udata watchedJobs:watchedJobs];
+		}
+		
+		enumerator = [[watchedJobs allObjects] objectEnumerator];
+		
+		while((job = [enumerator nextObject])) {
+			if(![job->transfer isWorking]) {
+				EV_SET(&event, wi_socket_descriptor([job->socket socket]), EVFILT_READ, EV_DELETE, 0, 0, NULL);
+				kevent(_queue, &event, 1, NULL, 0, NULL);
+				
+				[self _unparkJob:job watchedJobs:watchedJobs];
+			}
+		}
+		
+		[pool release];
+	}
+	
+	[watchedJobs release];
+}
+
+
+
+#pragma mark -
+
+- (void)setSize:(NSUInteger)size {
+	[_jobsLock lock];
+	
+	_size = WIMax(size, 1U);
+	
+	while(_workers - _busyWorkers < [_jobs count] && _workers < _size) {
+		_workers++;
+		
+		[WIThread detachNewThreadSelector:@selector(workerThread:) toTarget:self withObject:NULL];
+	}
+	
+	[_jobsLock unlockWithCondition:([_jobs count] > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+}
+
+
+
+- (NSUInteger)size {
+	return _size;
+}
+
+
+
+- (NSUInteger)numberOfWorkers {
+	return _workers;
+}
+
+
+
+- (NSUInteger)numberOfBusyWorkers {
+	return _busyWorkers;
+}
+
+
+
+- (NSUInteger)numberOfPendingJobs {
+	NSUInteger		count;
+	
+	[_jobsLock lock];
+	count = [_jobs count];
+	[_jobsLock unlockWithCondition:(count > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+	
+	return count;
+}
+
+
+
+- (NSUInteger)numberOfParkedJobs {
+	NSUInteger		count;
+	
+	[_parkedJobsLock lock];
+	count = [_parkedJobs count];
+	[_parkedJobsLock unlockWithCondition:(count > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+	
+	return count;
+}
+
+
+
+- (BOOL)hasPendingJobForTransfer:(WCTransfer *)transfer {
+	_WCTransferPoolJob		*job;
+	NSUInteger				i, count;
+	BOOL					pending;
+	
+	pending = NO;
+	
+	[_jobsLock lock];
+	
+	count = [_jobs count];
+	
+	for(i = 0; i < count && !pending; i++) {
+		job = [_jobs objectAtIndex:i];
+		
+		if(job->transfer == transfer)
+			pending = YES;
+	}
+	
+	[_jobsLock unlockWithCondition:(count > 0) ? _WCTransferPoolHasJobs : _WCTransferPoolNoJobs];
+	
+	return pending;
+}
+
+
+
+#pragma mark -
+
+- (void)addJobWithTarget:(id)target selector:(SEL)selector transfer:(WCTransfer *)transfer {
+	_WCTransferPoolJob		*job;
+	
+	job = [[_WCTransferPoolJob alloc] init];
+	job->target		= [target retain];
+	job->selector	= selector;
+	job->transfer	= [transfer retain];
+	
+	[self _addJob:job];
+	
+	[job release];
+}
+
+
+
+- (void)parkJobWithTarget:(id)target selector:(SEL)selector transfer:(WCTransfer *)transfer socket:(WISocket *)socket {
+	[self parkJobWithTarget:target selector:selector transfer:transfer object:NULL socket:socket];
+}
+
+
+
+- (void)parkJobWithTarget:(id)target selector:(SEL)selector transfer:(WCTransfer *)transfer object:(id)object socket:(WISocket *)socket {
+	_WCTransferPoolJob		*job;
+	
+	job = [[_WCTransferPoolJob alloc] init];
+	job->target		= [target retain];
+	job->selector	= selector;
+	job->transfer	= [transfer retain];
+	job->object		= [object retain];
+	job->socket		= [socket retain];
+	
+	[_parkedJobsLock lock];
+	
+	[_parkedJobs addObject:job];
+	
+	if(!_monitoring) {
+		_monitoring = YES;
+		
+		[WIThread detachNewThreadSelector:@selector(monitorThread:) toTarget:self withObject:NULL];
+	}
+	
+	[_parkedJobsLock unlockWithCondition:_WCTransferPoolHasJobs];
+	
+	[job release];
+	
+	[self wakeUp];
+}
+
+
+
+- (void)wakeUp {
+	char	c = 0;
+	
+	write(_pipe[1], &c, 1);
+}
+
+@end
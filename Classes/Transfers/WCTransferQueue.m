@@ -0,0 +1,242 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#import "WCTransfer.h"
+#import "WCTransferQueue.h"
+
+static WIFileOffset _WCTransferQueueRemainingSize(WCTransfer *transfer) {
+	WIFileOffset	transferred;
+	
+	if([transfer isFolder] && [transfer size] == 0)
+		return ULLONG_MAX;
+	
+	transferred = [transfer dataTransferred] + [transfer rsrcTransferred];
+	
+	return ([transfer size] > transferred) ? [transfer size] - transferred : 0;
+}
+
+
+
+static NSComparisonResult _WCTransferQueueCompare(WCTransfer *transfer1, WCTransfer *transfer2, NSUInteger policy) {
+	WIFileOffset	remaining1, remaining2;
+	
+	if([transfer1 priority] > [transfer2 priority])
+		return NSOrderedAscending;
+	else if([transfer1 priority] < [transfer2 priority])
+		return NSOrderedDescending;
+	
+	if(policy == WCTransferQueuePolicyShortestRemaining) {
+		remaining1 = _WCTransferQueueRemainingSize(transfer1);
+		remaining2 = _WCTransferQueueRemainingSize(transfer2);
+		
+		if(remaining1 < remaining2)
+			return NSOrderedAscending;
+		else if(remaining1 > remaining2)
+			return NSOrderedDescending;
+	}
+	
+	return NSOrderedSame;
+}
+
+
+
+@interface WCTransferQueue(Private)
+
+- (NSMutableArray *)_transfersForConnection:(WCServerConnection *)connection class:(Class)class create:(BOOL)create;
+
+@end
+
+
+@implementation WCTransferQueue(Private)
+
+- (NSMutableArray *)_transfersForConnection:(WCServerConnection *)connection class:(Class)class create:(BOOL)create {
+	NSMutableArray		*queues;
+	NSUInteger			index;
+	
+	queues = (NSMutableArray *) CFDictionaryGetValue(_queues, connection);
+	
+	if(!queues) {
+		if(!create)
+			return NULL;
+		
+		queues = [NSMutableArray arrayWithObjects:[NSMutableArray array], [NSMutableArray array], NULL];
+		
+		CFDictionarySetValue(_queues, connection, queues);
+	}
+	
+	index = [class isSubclassOfClass:[WCDownloadTransfer class]] ? 0 : 1;
+	
+	return [queues objectAtIndex:index];
+}
+
+@end
+
+
+
+@implementation WCTransferQueue
+
++ (id)queue {
+	return [[[self alloc] init] autorelease];
+}
+
+
+
+- (id)init {
+	self = [super init];
+	
+	_queues		= CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+	_transfers	= CFDictionaryCreateMutable(NULL, 0, NULL, &kCFTypeDictionaryValueCallBacks);
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	CFRelease(_queues);
+	CFRelease(_transfers);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (NSUInteger)count {
+	return CFDictionaryGetCount(_transfers);
+}
+
+
+
+- (BOOL)containsTransfer:(WCTransfer *)transfer {
+	return CFDictionaryContainsKey(_transfers, transfer);
+}
+
+
+
+- (WCTransfer *)firstTransferForConnection:(WCServerConnection *)connection class:(Class)class {
+	NSMutableArray		*transfers;
+	WCTransfer			*transfer;
+	
+	transfers = [self _transfersForConnection:connection class:class create:NO];
+	
+	while([transfers count] > 0) {
+		transfer = [transfers objectAtIndex:0];
+		
+		if([transfer connection] == connection && [transfer state] == WCTransferLocallyQueued)
+			return transfer;
+		
+		[self removeTransfer:transfer];
+	}
+	
+	return NULL;
+}
+
+
+
+#pragma mark -
+
+- (void)addTransfer:(WCTransfer *)transfer policy:(NSUInteger)policy {
+	NSMutableArray		*transfers;
+	NSUInteger			low, high, middle;
+	
+	if(![transfer connection])
+		return;
+	
+	[self removeTransfer:transfer];
+	
+	transfers	= [self _transfersForConnection:[transfer connection] class:[transfer class] create:YES];
+	low			= 0;
+	high		= [transfers count];
+	
+	while(low < high) {
+		middle = (low + high) / 2;
+		
+		if(_WCTransferQueueCompare(transfer, [transfers objectAtIndex:middle], policy) == NSOrderedAscending)
+			high = middle;
+		else
+			low = middle + 1;
+	}
+	
+	[transfers insertObject:transfer atIndex:low];
+	
+	CFDictionarySetValue(_transfers, transfer, transfers);
+}
+
+
+
+- (void)removeTransfer:(WCTransfer *)transfer {
+	NSMutableArray		*transfers;
+	
+	transfers = (NSMutableArray *) CFDictionaryGetValue(_transfers, transfer);
+	
+	if(transfers) {
+		[transfer retain];
+		[transfers removeObjectIdenticalTo:transfer];
+		
+		CFDictionaryRemoveValue(_transfers, transfer);
+		
+		[transfer release];
+	}
+}
+
+
+
+- (void)removeTransfersForConnection:(WCServerConnection *)connection {
+	NSEnumerator		*enumerator;
+	NSMutableArray		*queues, *transfers;
+	WCTransfer			*transfer;
+	
+	queues = (NSMutableArray *) CFDictionaryGetValue(_queues, connection);
+	
+	if(!queues)
+		return;
+	
+	enumerator = [queues objectEnumerator];
+	
+	while((transfers = [enumerator nextObject])) {
+		while([transfers count] > 0) {
+			transfer = [transfers lastObject];
+			
+			CFDictionaryRemoveValue(_transfers, transfer);
+			
+			[transfers removeLastObject];
+		}
+	}
+	
+	CFDictionaryRemoveValue(_queues, connection);
+}
+
+
+
+- (void)removeAllTransfers {
+	CFDictionaryRemoveAllValues(_queues);
+	CFDictionaryRemoveAllValues(_transfers);
+}
+
+@end
@@ -0,0 +1,69 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+@interface WCTransferReader : WIObject {
+	int									_dataFD;
+	int									_rsrcFD;
+	WIFileOffset						_dataLength;
+	WIFileOffset						_rsrcLength;
+	
+	struct _WCTransferReaderBuffer		*_buffers;
+	NSUInteger							_bufferSize;
+	NSUInteger							_bufferCount;
+	NSUInteger							_head;
+	NSUInteger							_tail;
+	NSUInteger							_filled;
+	
+	pthread_mutex_t						_mutex;
+	pthread_cond_t						_cond;
+	
+	BOOL								_finished;
+	BOOL								_closing;
+	BOOL								_closed;
+	BOOL								_changed;
+	int									_error;
+	
+	NSTimeInterval						_readStallTime;
+	NSTimeInterval						_writeStallTime;
+}
+
++ (NSUInteger)defaultBufferSize;
++ (NSUInteger)defaultBufferCount;
+
+- (id)initWithDataDescriptor:(int)dataFD dataLength:(WIFileOffset)dataLength rsrcDescriptor:(int)rsrcFD rsrcLength:(WIFileOffset)rsrcLength bufferSize:(NSUInteger)bufferSize bufferCount:(NSUInteger)bufferCount;
+
+- (NSInteger)readBuffer:(void **)buffer dataFork:(BOOL *)dataFork;
+- (void)releaseBuffer;
+- (void)close;
+- (int)error;
+- (BOOL)fileChanged;
+
+- (NSTimeInterval)readStallTime;
+- (NSTimeInterval)writeStallTime;
+
+@end
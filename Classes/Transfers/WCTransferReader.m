@@ -0,0 +1,267 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "WCTime.h"
+#import "WCTransferReader.h"
+
+struct _WCTransferReaderBuffer {
+	char								*bytes;
+	NSUInteger							length;
+	BOOL								dataFork;
+};
+
+
+@implementation WCTransferReader
+
++ (NSUInteger)defaultBufferSize {
+	NSUInteger		size;
+	
+	size = [[WCSettings settings] integerForKey:WCTransferUploadBufferSize];
+	
+	return WIMax(size, 65536U);
+}
+
+
+
++ (NSUInteger)defaultBufferCount {
+	NSUInteger		count;
+	
+	count = [[WCSettings settings] integerForKey:WCTransferUploadBufferCount];
+	
+	return WIMax(count, 2U);
+}
+
+
+
+#pragma mark -
+
+- (id)initWithDataDescriptor:(int)dataFD dataLength:(WIFileOffset)dataLength rsrcDescriptor:(int)rsrcFD rsrcLength:(WIFileOffset)rsrcLength bufferSize:(NSUInteger)bufferSize bufferCount:(NSUInteger)bufferCount {
+	NSUInteger		i;
+	
+	self = [super init];
+	
+	_dataFD			= dataFD;
+	_dataLength		= dataLength;
+	_rsrcFD			= rsrcFD;
+	_rsrcLength		= rsrcLength;
+	_bufferSize		= bufferSize;
+	_bufferCount	= bufferCount;
+	_buffers		= calloc(_bufferCount, sizeof(struct _WCTransferReaderBuffer));
+	
+	for(i = 0; i < _bufferCount; i++)
+		_buffers[i].bytes = malloc(_bufferSize);
+	
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, NULL);
+	
+	fcntl(_dataFD, F_RDAHEAD, 1);
+	
+	[WIThread detachNewThreadSelector:@selector(readerThread:) toTarget:self withObject:NULL];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	NSUInteger		i;
+	
+	for(i = 0; i < _bufferCount; i++)
+		free(_buffers[i].bytes);
+	
+	free(_buffers);
+	
+	pthread_mutex_destroy(&_mutex);
+	pthread_cond_destroy(&_cond);
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)readerThread:(id)arg {
+	NSAutoreleasePool				*pool;
+	struct _WCTransferReaderBuffer	*buffer;
+	NSTimeInterval					interval;
+	WIFileOffset					*length;
+	ssize_t							bytes;
+	BOOL							dataFork;
+	
+	pool = [[NSAutoreleasePool alloc] init];
+	
+	pthread_mutex_lock(&_mutex);
+	
+	while(!_closing && (_dataLength > 0 || _rsrcLength > 0)) {
+		if(_filled == _bufferCount) {
+			interval = WCTimeInterval();
+			
+			while(_filled == _bufferCount && !_closing)
+				pthread_cond_wait(&_cond, &_mutex);
+			
+			_writeStallTime += WCTimeInterval() - interval;
+			
+			continue;
+		}
+		
+		buffer		= &_buffers[_head];
+		dataFork	= (_dataLength > 0);
+		length		= dataFork ? &_dataLength : &_rsrcLength;
+		
+		pthread_mutex_unlock(&_mutex);
+		
+		do {
+			bytes = read(dataFork ? _dataFD : _rsrcFD, buffer->bytes, WIMin(_bufferSize, *length));
+		} while(bytes < 0 && errno == EINTR);
+		
+		pthread_mutex_lock(&_mutex);
+		
+		if(bytes <= 0) {
+			if(bytes < 0)
+				_error = errno;
+			else
+				_changed = YES;
+			
+			break;
+		}
+		
+		buffer->length		= bytes;
+		buffer->dataFork	= dataFork;
+		*length				-= bytes;
+		
+		_head = (_head + 1) % _bufferCount;
+		_filled++;
+		
+		pthread_cond_broadcast(&_cond);
+	}
+	
+	_finished = YES;
+	
+	pthread_cond_broadcast(&_cond);
+	
+	while(!_closing)
+		pthread_cond_wait(&_cond, &_mutex);
+	
+	_closed = YES;
+	
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	
+	[pool release];
+}
+
+
+
+#pragma mark -
+
+- (NSInteger)readBuffer:(void **)buffer dataFork:(BOOL *)dataFork {
+	NSTimeInterval		interval;
+	NSInteger			length;
+	
+	pthread_mutex_lock(&_mutex);
+	
+	if(_filled == 0 && !_finished) {
+		interval = WCTimeInterval();
+		
+		while(_filled == 0 && !_finished)
+			pthread_cond_wait(&_cond, &_mutex);
+		
+		_readStallTime += WCTimeInterval() - interval;
+	}
+	
+	if(_filled > 0) {
+		*buffer		= _buffers[_tail].bytes;
+		*dataFork	= _buffers[_tail].dataFork;
+		length		= _buffers[_tail].length;
+	} else {
+		length		= (_error != 0 || _changed) ? -1 : 0;
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	return length;
+}
+
+
+
+- (void)releaseBuffer {
+	pthread_mutex_lock(&_mutex);
+	
+	if(_filled > 0) {
+		_tail = (_tail + 1) % _bufferCount;
+		_filled--;
+	
+		pthread_cond_broadcast(&_cond);
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+}
+
+
+
+- (void)close {
+	pthread_mutex_lock(&_mutex);
+	
+	_closing = YES;
+	
+	pthread_cond_broadcast(&_cond);
+	
+	while(!_closed)
+		pthread_cond_wait(&_cond, &_mutex);
+	
+	pthread_mutex_unlock(&_mutex);
+}
+
+
+
+- (int)error {
+	return _error;
+}
+
+
+
+- (BOOL)fileChanged {
+	return _changed;
+}
+
+
+
+#pragma mark -
+
+- (NSTimeInterval)readStallTime {
+	return _readStallTime;
+}
+
+
+
+- (NSTimeInterval)writeStallTime {
+	return _writeStallTime;
+}
+
+@end
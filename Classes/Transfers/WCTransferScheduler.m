@@ -0,0 +1,386 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "WCPreferences.h"
+#import "WCTime.h"
+#import "WCTransfer.h"
+#import "WCTransferScheduler.h"
+
+#define _WCTransferSchedulerBurstInterval			0.25
+#define _WCTransferSchedulerMinimumBurst			65536.0
+#define _WCTransferSchedulerMaximumWait				1.0
+#define _WCTransferSchedulerWaitSlice				0.05
+
+
+@interface _WCTransferSchedulerEntry : NSObject {
+@public
+	WCTransfer								*transfer;
+	NSString								*server;
+	BOOL									download;
+	double									weight;
+	NSUInteger								references;
+	
+	double									cap;
+	double									rate;
+	double									tokens;
+	NSTimeInterval							time;
+}
+
+@end
+
+
+@implementation _WCTransferSchedulerEntry
+
+- (void)dealloc {
+	[server release];
+	
+	[super dealloc];
+}
+
+@end
+
+
+
+static inline double _WCTransferSchedulerLimit(NSUInteger limit) {
+	return (limit > 0) ? (double) limit : HUGE_VAL;
+}
+
+
+
+static void _WCTransferSchedulerDistribute(NSArray *entries, double capacity) {
+	_WCTransferSchedulerEntry	*entry;
+	NSMutableArray				*unfixed;
+	NSUInteger					i;
+	double						weight;
+	BOOL						fixed;
+	
+	if(capacity == HUGE_VAL)
+		return;
+	
+	unfixed = [[entries mutableCopy] autorelease];
+	
+	do {
+		fixed	= NO;
+		weight	= 0.0;
+		
+		for(i = 0; i < [unfixed count]; i++)
+			weight += ((_WCTransferSchedulerEntry *) [unfixed objectAtIndex:i])->weight;
+		
+		for(i = 0; i < [unfixed count]; i++) {
+			entry = [unfixed objectAtIndex:i];
+			
+			if(entry->rate <= capacity * entry->weight / weight) {
+				capacity -= entry->rate;
+				
+				[unfixed removeObjectAtIndex:i];
+				
+				fixed = YES;
+				
+				break;
+			}
+		}
+	} while(fixed && [unfixed count] > 0);
+	
+	for(i = 0; i < [unfixed count]; i++) {
+		entry = [unfixed objectAtIndex:i];
+		entry->rate = WIMin(entry->rate, capacity * entry->weight / weight);
+	}
+}
+
+
+
+@interface WCTransferScheduler(Private)
+
+- (_WCTransferSchedulerEntry *)_entryForTransfer:(WCTransfer *)transfer;
+- (void)_recalculateRates;
+
+@end
+
+
+@implementation WCTransferScheduler(Private)
+
+- (_WCTransferSchedulerEntry *)_entryForTransfer:(WCTransfer *)transfer {
+	_WCTransferSchedulerEntry	*entry;
+	NSUInteger					i, count;
+	
+	count = [_entries count];
+	
+	for(i = 0; i < count; i++) {
+		entry = [_entries objectAtIndex:i];
+		
+		if(entry->transfer == transfer)
+			return entry;
+	}
+	
+	return NULL;
+}
+
+
+
+- (void)_recalculateRates {
+	NSMutableDictionary			*servers;
+	NSMutableArray				*downloads, *uploads, *entries;
+	NSEnumerator				*enumerator;
+	NSDictionary				*bookmark;
+	NSString					*key;
+	_WCTransferSchedulerEntry	*entry;
+	NSUInteger					i, count;
+	double						limit;
+	
+	servers		= [NSMutableDictionary dictionary];
+	downloads	= [NSMutableArray array];
+	uploads		= [NSMutableArray array];
+	count		= [_entries count];
+	
+	for(i = 0; i < count; i++) {
+		entry = [_entries objectAtIndex:i];
+		entry->rate = entry->cap;
+		
+		key = [NSSWF:@"%@ %d", entry->server, entry->download];
+		entries = [servers objectForKey:key];
+		
+		if(!entries) {
+			entries = [NSMutableArray array];
+			
+			[servers setObject:entries forKey:key];
+		}
+		
+		[entries addObject:entry];
+		
+		if(entry->download)
+			[downloads addObject:entry];
+		else
+			[uploads addObject:entry];
+	}
+	
+	enumerator = [servers objectEnumerator];
+	
+	while((entries = [enumerator nextObject])) {
+		entry		= [entries objectAtIndex:0];
+		bookmark	= [entry->transfer bookmark];
+		
+		if(entry->download)
+			limit = _WCTransferSchedulerLimit([bookmark unsignedIntegerForKey:WCBookmarksDownloadSpeedLimit]);
+		else
+			limit = _WCTransferSchedulerLimit([bookmark unsignedIntegerForKey:WCBookmarksUploadSpeedLimit]);
+		
+		_WCTransferSchedulerDistribute(entries, limit);
+	}
+	
+	_WCTransferSchedulerDistribute(downloads,
+		_WCTransferSchedulerLimit([[WCSettings settings] integerForKey:WCTransferDownloadSpeedLimit]));
+	_WCTransferSchedulerDistribute(uploads,
+		_WCTransferSchedulerLimit([[WCSettings settings] integerForKey:WCTransferUploadSpeedLimit]));
+}
+
+@end
+
+
+
+@implementation WCTransferScheduler
+
++ (WCTransferScheduler *)scheduler {
+	static id	sharedScheduler;
+	
+	if(!sharedScheduler)
+		sharedScheduler = [[self alloc] init];
+	
+	return sharedScheduler;
+}
+
+
+
+- (id)init {
+	self = [super init];
+	
+	_entries	= [[NSMutableArray alloc] init];
+	_lock		= [[NSLock alloc] init];
+	
+	[[NSNotificationCenter defaultCenter]
+		addObserver:self
+		   selector:@selector(preferencesDidChange:)
+			   name:WCPreferencesDidChangeNotification];
+	
+	[[NSNotificationCenter defaultCenter]
+		addObserver:self
+		   selector:@selector(preferencesDidChange:)
+			   name:WCBookmarksDidChangeNotification];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	[[NSNotificationCenter defaultCenter] removeObserver:self];
+	
+	[_entries release];
+	[_lock release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)preferencesDidChange:(NSNotification *)notification {
+	[self refreshLimits];
+}
+
+
+
+#pragma mark -
+
+- (void)addTransfer:(WCTransfer *)transfer weight:(double)weight {
+	_WCTransferSchedulerEntry	*entry;
+	
+	[_lock lock];
+	
+	entry = [self _entryForTransfer:transfer];
+	
+	if(!entry) {
+		entry = [[_WCTransferSchedulerEntry alloc] init];
+		entry->transfer		= transfer;
+		entry->server		= [[[transfer connection] identifier] retain];
+		entry->download		= [transfer isKindOfClass:[WCDownloadTransfer class]];
+		entry->weight		= WIMax(weight, 0.01);
+		entry->cap			= _WCTransferSchedulerLimit([transfer speedLimit]);
+		entry->time			= WCTimeInterval();
+		
+		[_entries addObject:entry];
+		[entry release];
+		
+		[self _recalculateRates];
+	}
+	
+	entry->references++;
+	
+	[_lock unlock];
+}
+
+
+
+- (void)removeTransfer:(WCTransfer *)transfer {
+	_WCTransferSchedulerEntry	*entry;
+	
+	[_lock lock];
+	
+	entry = [self _entryForTransfer:transfer];
+	
+	if(entry && --entry->references == 0) {
+		[_entries removeObject:entry];
+		
+		[self _recalculateRates];
+	}
+	
+	[_lock unlock];
+}
+
+
+
+- (void)refreshLimits {
+	_WCTransferSchedulerEntry	*entry;
+	NSUInteger					i, count;
+	
+	[_lock lock];
+	
+	count = [_entries count];
+	
+	for(i = 0; i < count; i++) {
+		entry = [_entries objectAtIndex:i];
+		entry->cap = _WCTransferSchedulerLimit([entry->transfer speedLimit]);
+	}
+	
+	[self _recalculateRates];
+	
+	[_lock unlock];
+}
+
+
+
+#pragma mark -
+
+- (NSUInteger)burstSizeForTransfer:(WCTransfer *)transfer {
+	_WCTransferSchedulerEntry	*entry;
+	NSUInteger					size;
+	
+	size = NSUIntegerMax;
+	
+	[_lock lock];
+	
+	entry = [self _entryForTransfer:transfer];
+	
+	if(entry && entry->rate != HUGE_VAL)
+		size = WIMax(entry->rate * _WCTransferSchedulerBurstInterval, _WCTransferSchedulerMinimumBurst);
+	
+	[_lock unlock];
+	
+	return size;
+}
+
+
+
+- (NSTimeInterval)waitForBytes:(NSUInteger)bytes forTransfer:(WCTransfer *)transfer {
+	_WCTransferSchedulerEntry	*entry;
+	NSTimeInterval				time, interval, slice, remaining;
+	
+	interval = 0.0;
+	
+	[_lock lock];
+	
+	entry = [self _entryForTransfer:transfer];
+	
+	if(entry && entry->rate != HUGE_VAL) {
+		time = WCTimeInterval();
+		
+		entry->tokens += (time - entry->time) * entry->rate;
+		entry->tokens = WIMin(entry->tokens, WIMax(entry->rate * _WCTransferSchedulerBurstInterval, _WCTransferSchedulerMinimumBurst));
+		entry->tokens -= bytes;
+		entry->time = time;
+		
+		if(entry->tokens < 0.0)
+			interval = WIMin(-entry->tokens / WIMax(entry->rate, 1.0), _WCTransferSchedulerMaximumWait);
+	}
+	
+	[_lock unlock];
+	
+	remaining = interval;
+	
+	while(remaining > 0.0 && ![transfer isTerminating]) {
+		slice = WIMin(remaining, _WCTransferSchedulerWaitSlice);
+		
+		usleep(slice * 1000000.0);
+		
+		remaining -= slice;
+	}
+	
+	return interval - remaining;
+}
+
+@end
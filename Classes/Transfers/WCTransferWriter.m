@@ -0,0 +1,362 @@
+/* $Id$ */
+
+/*
+ *  Copyright (c) 2009 Axel Andersson
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions
+ *  are met:
+ *  1. Redistributions of source code must retain the above copyright
+ *     notice, this list of conditions and the following disclaimer.
+ *  2. Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT,
+ * INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+ * STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN
+ * ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#import "WCTime.h"
+#import "WCTransferManifest.h"
+#import "WCTransferWriter.h"
+
+struct _WCTransferWriterBuffer {
+	char								*bytes;
+	NSUInteger							length;
+	BOOL								dataFork;
+};
+
+
+static BOOL _WCTransferWriterWriteVector(int fd, struct iovec *iov, int count) {
+	ssize_t		bytes;
+	
+	while(count > 0) {
+		bytes = writev(fd, iov, count);
+		
+		if(bytes < 0) {
+			if(errno == EINTR)
+				continue;
+			
+			return NO;
+		}
+		
+		while(count > 0 && (size_t) bytes >= iov->iov_len) {
+			bytes -= iov->iov_len;
+			
+			iov++;
+			count--;
+		}
+		
+		if(count > 0) {
+			iov->iov_base	= (char *) iov->iov_base + bytes;
+			iov->iov_len	-= bytes;
+		}
+	}
+	
+	return YES;
+}
+
+
+
+@interface WCTransferWriter(Private)
+
+- (void)_commitBuffer;
+
+@end
+
+
+@implementation WCTransferWriter(Private)
+
+- (void)_commitBuffer {
+	NSTimeInterval		interval;
+	
+	if(_buffers[_head].length == 0)
+		return;
+	
+	pthread_mutex_lock(&_mutex);
+	
+	_head = (_head + 1) % _bufferCount;
+	_filled++;
+	
+	pthread_cond_broadcast(&_cond);
+	
+	if(_filled == _bufferCount && _error == 0) {
+		interval = WCTimeInterval();
+		
+		while(_filled == _bufferCount && _error == 0)
+			pthread_cond_wait(&_cond, &_mutex);
+		
+		_writeStallTime += WCTimeInterval() - interval;
+	}
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	_buffers[_head].length = 0;
+}
+
+@end
+
+
+
+@implementation WCTransferWriter
+
++ (NSUInteger)defaultBufferSize {
+	NSUInteger		size;
+	
+	size = [[WCSettings settings] integerForKey:WCTransferDownloadBufferSize];
+	
+	return WIMax(size, 65536U);
+}
+
+
+
++ (NSUInteger)defaultBufferCount {
+	NSUInteger		count;
+	
+	count = [[WCSettings settings] integerForKey:WCTransferDownloadBufferCount];
+	
+	return WIMax(count, 2U);
+}
+
+
+
+#pragma mark -
+
+- (id)initWithDataDescriptor:(int)dataFD rsrcDescriptor:(int)rsrcFD bufferSize:(NSUInteger)bufferSize bufferCount:(NSUInteger)bufferCount {
+	NSUInteger		i;
+	
+	self = [super init];
+	
+	_dataFD			= dataFD;
+	_rsrcFD			= rsrcFD;
+	_bufferSize		= bufferSize;
+	_bufferCount	= bufferCount;
+	_buffers		= calloc(_bufferCount, sizeof(struct _WCTransferWriterBuffer));
+	
+	for(i = 0; i < _bufferCount; i++)
+		_buffers[i].bytes = malloc(_bufferSize);
+	
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, NULL);
+	
+	/* There is no write-side sequential hint, F_RDAHEAD only affects reads */
+	fcntl(_dataFD, F_NOCACHE, 1);
+	
+	[WIThread detachNewThreadSelector:@selector(writerThread:) toTarget:self withObject:NULL];
+	
+	return self;
+}
+
+
+
+- (void)dealloc {
+	NSUInteger		i;
+	
+	for(i = 0; i < _bufferCount; i++)
+		free(_buffers[i].bytes);
+	
+	free(_buffers);
+	
+	pthread_mutex_destroy(&_mutex);
+	pthread_cond_destroy(&_cond);
+	
+	[_manifest release];
+	
+	[super dealloc];
+}
+
+
+
+#pragma mark -
+
+- (void)writerThread:(id)arg {
+	NSAutoreleasePool		*pool;
+	struct iovec			iov[16];
+	NSTimeInterval			interval;
+	NSUInteger				i, count;
+	BOOL					dataFork;
+	int						fd;
+	
+	pool = [[NSAutoreleasePool alloc] init];
+	
+	pthread_mutex_lock(&_mutex);
+	
+	while(YES) {
+		if(_filled == 0 && !_closing) {
+			interval = WCTimeInterval();
+			
+			while(_filled == 0 && !_closing)
+				pthread_cond_wait(&_cond, &_mutex);
+			
+			_readStallTime += WCTimeInterval() - interval;
+		}
+		
+		if(_filled == 0 && _closing)
+			break;
+		
+		dataFork	= _buffers[_tail].dataFork;
+		count		= 0;
+		
+		for(i = 0; i < _filled && count < sizeof(iov) / sizeof(*iov); i++) {
+			struct _WCTransferWriterBuffer		*buffer = &_buffers[(_tail + i) % _bufferCount];
+			
+			if(buffer->dataFork != dataFork)
+				break;
+			
+			iov[count].iov_base		= buffer->bytes;
+			iov[count].iov_len		= buffer->length;
+			count++;
+		}
+		
+		pthread_mutex_unlock(&_mutex);
+		
+		fd = dataFork ? _dataFD : _rsrcFD;
+		
+		if(_error == 0 && !_WCTransferWriterWriteVector(fd, iov, count))
+			_error = errno;
+		
+		if(_error == 0 && dataFork && _manifest) {
+			for(i = 0; i < count; i++) {
+				struct _WCTransferWriterBuffer		*buffer = &_buffers[(_tail + i) % _bufferCount];
+				
+				[_manifest updateWithBytes:buffer->bytes length:buffer->length];
+			}
+		}
+		
+		pthread_mutex_lock(&_mutex);
+		
+		_tail = (_tail + count) % _bufferCount;
+		_filled -= count;
+		
+		pthread_cond_broadcast(&_cond);
+	}
+	
+	_closed = YES;
+	
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_mutex);
+	
+	[pool release];
+}
+
+
+
+#pragma mark -
+
+- (BOOL)preallocateDataLength:(WIFileOffset)dataLength {
+	fstore_t		store;
+	
+	if(dataLength == 0)
+		return YES;
+	
+	store.fst_flags			= F_ALLOCATECONTIG | F_ALLOCATEALL;
+	store.fst_posmode		= F_PEOFPOSMODE;
+	store.fst_offset		= 0;
+	store.fst_length		= dataLength;
+	store.fst_bytesalloc	= 0;
+	
+	if(fcntl(_dataFD, F_PREALLOCATE, &store) < 0) {
+		store.fst_flags = F_ALLOCATEALL;
+		
+		if(fcntl(_dataFD, F_PREALLOCATE, &store) < 0)
+			return NO;
+	}
+	
+	return YES;
+}
+
+
+
+- (void)setManifest:(WCTransferManifest *)manifest {
+	[manifest retain];
+	[_manifest release];
+	
+	_manifest = manifest;
+}
+
+
+
+#pragma mark -
+
+- (BOOL)writeBytes:(const void *)bytes length:(NSUInteger)length dataFork:(BOOL)dataFork {
+	struct _WCTransferWriterBuffer		*buffer;
+	NSUInteger							bytesToCopy;
+	
+	while(length > 0) {
+		if(_error != 0)
+			return NO;
+		
+		buffer = &_buffers[_head];
+		
+		if(buffer->length > 0 && buffer->dataFork != dataFork) {
+			[self _commitBuffer];
+			
+			buffer = &_buffers[_head];
+		}
+		
+		buffer->dataFork	= dataFork;
+		bytesToCopy			= WIMin(length, _bufferSize - buffer->length);
+		
+		memcpy(buffer->bytes + buffer->length, bytes, bytesToCopy);
+		
+		buffer->length		+= bytesToCopy;
+		bytes				= (const char *) bytes + bytesToCopy;
+		length				-= bytesToCopy;
+		
+		if(buffer->length == _bufferSize)
+			[self _commitBuffer];
+	}
+	
+	return (_error == 0);
+}
+
+
+
+- (BOOL)close {
+	[self _commitBuffer];
+	
+	pthread_mutex_lock(&_mutex);
+	
+	_closing = YES;
+	
+	pthread_cond_broadcast(&_cond);
+	
+	while(!_closed)
+		pthread_cond_wait(&_cond, &_mutex);
+	
+	pthread_mutex_unlock(&_mutex);
+	
+	return (_error == 0);
+}
+
+
+
+- (int)error {
+	return _error;
+}
+
+
+
+#pragma mark -
+
+- (NSTimeInterval)readStallTime {
+	return _readStallTime;
+}
+
+
+
+- (NSTimeInterval)writeStallTime {
+	return _writeStallTime;
+}
+
+@end
@@ -26,7 +26,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-@class WCErrorQueue, WCFile, WCTransfer;
+@class WCErrorQueue, WCFile, WCTransfer, WCTransferConnectionPool, WCTransferJournal, WCTransferPool, WCTransferQueue;
 
 @interface WCTransfers : WIWindowController {
 	IBOutlet WITableView					*_transfersTableView;
@@ -50,11 +50,17 @@
 
 	NSImage									*_folderImage;
 	NSTimer									*_timer;
+	NSTimeInterval							_statsTime;
 	NSLock									*_lock;
 	
 	WISizeFormatter							*_sizeFormatter;
 	WITimeIntervalFormatter					*_timeIntervalFormatter;
 	
+	WCTransferPool							*_transferPool;
+	WCTransferConnectionPool				*_connectionPool;
+	WCTransferJournal						*_journal;
+	WCTransferQueue							*_queue;
+	
 	Class									_quickLookPanelClass;
 }
 
@@ -67,6 +73,8 @@
 - (BOOL)downloadFiles:(NSArray *)files;
 - (BOOL)downloadFiles:(NSArray *)files toFolder:(NSString *)destination;
 - (BOOL)uploadPaths:(NSArray *)paths toFolder:(WCFile *)destination;
+- (BOOL)syncFiles:(NSArray *)files dryRun:(BOOL)dryRun;
+- (BOOL)syncPaths:(NSArray *)paths toFolder:(WCFile *)destination dryRun:(BOOL)dryRun;
 
 - (IBAction)deleteDocument:(id)sender;
 - (IBAction)start:(id)sender;
@@ -78,5 +86,7 @@
 - (IBAction)quickLook:(id)sender;
 - (IBAction)revealInFinder:(id)sender;
 - (IBAction)revealInFiles:(id)sender;
+- (IBAction)raisePriority:(id)sender;
+- (IBAction)lowerPriority:(id)sender;
 
 @end
@@ -35,26 +35,88 @@
 #import "WCFiles.h"
 #import "WCPreferences.h"
 #import "WCPublicChat.h"
+#import "WCPublicChatController.h"
 #import "WCServer.h"
 #import "WCServerConnection.h"
 #import "WCServerInfo.h"
 #import "WCStats.h"
+#import "WCTime.h"
 #import "WCTransfer.h"
+#import "WCTransferBenchmark.h"
 #import "WCTransferCell.h"
 #import "WCTransferConnection.h"
+#import "WCTransferConnectionPool.h"
+#import "WCTransferJournal.h"
+#import "WCTransferManifest.h"
+#import "WCTransferPool.h"
+#import "WCTransferQueue.h"
+#import "WCTransferReader.h"
+#import "WCTransferScheduler.h"
+#import "WCTransferWriter.h"
 #import "WCTransfers.h"
 
 #define WCTransfersFileExtension				@"WiredTransfer"
 #define WCTransfersFileExtendedAttributeName	@"com.zankasoftware.WiredTransfer"
 #define WCTransferPboardType					@"WCTransferPboardType"
+#define WCTransfersJournalPath					@"~/Library/Application Support/Wired Client/Transfers.journal"
+#define WCTransfersPipelineWindow				32
+#define WCTransfersLoginTransaction				0xFFFFFFFFU
+#define WCTransfersUploadTransaction			1
+#define WCTransfersRefreshInterval				0.2
+#define WCTransfersMinimumChunkSize				8192
+#define WCTransfersMaximumChunkSize				4194304
+#define WCTransfersSyncDateTolerance			2.0
+
+struct _WCTransfersUploadRequest {
+	WCFile								*file;
+	WIP7UInt32							transaction;
+	NSTimeInterval						time;
+};
+
+
+@interface _WCTransfersStream : NSObject {
+@public
+	WCTransferConnection					*connection;
+	WCFile									*file;
+}
+
+@end
+
+
+@implementation _WCTransfersStream
+
+- (void)dealloc {
+	[connection release];
+	[file release];
+	
+	[super dealloc];
+}
 
+@end
 
-static inline NSTimeInterval _WCTransfersTimeInterval(void) {
-	struct timeval		tv;
 
-	gettimeofday(&tv, NULL);
 
-	return tv.tv_sec + ((double) tv.tv_usec / 1000000.0);
+static NSString * _WCTransfersSyncChange(WCFile *file, NSString *localPath, BOOL download) {
+	NSDictionary		*attributes;
+	NSTimeInterval		interval;
+	
+	attributes = [[NSFileManager defaultManager] fileAttributesAtPath:localPath traverseLink:YES];
+	
+	if(!attributes)
+		return NSLS(@"New", @"Sync change");
+	
+	if([attributes fileSize] != [file dataSize])
+		return NSLS(@"Size differs", @"Sync change");
+	
+	interval = [[file modificationDate] timeIntervalSinceDate:[attributes fileModificationDate]];
+	
+	if(download && interval > WCTransfersSyncDateTolerance)
+		return NSLS(@"Newer on server", @"Sync change");
+	
+	if(!download && interval < -WCTransfersSyncDateTolerance)
+		return NSLS(@"Newer on disk", @"Sync change");
+	
+	return NULL;
 }
 
 
@@ -70,6 +132,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 - (BOOL)_validateQuickLook;
 - (BOOL)_validateRevealInFinder;
 - (BOOL)_validateRevealInFiles;
+- (BOOL)_validatePriority;
 
 - (void)_themeDidChange;
 - (void)_reload;
@@ -79,36 +142,62 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 - (NSArray *)_selectedTransfers;
 - (WCTransfer *)_unfinishedTransferWithPath:(NSString *)path connection:(WCServerConnection *)connection;
 - (WCTransfer *)_transferWithState:(WCTransferState)state;
-- (WCTransfer *)_transferWithState:(WCTransferState)state class:(Class)class;
 - (WCTransfer *)_transferWithTransaction:(NSUInteger)transaction;
 - (NSUInteger)_numberOfWorkingTransfersOfClass:(Class)class connection:(WCServerConnection *)connection;
+- (NSUInteger)_numberOfStreamsForTransfer:(WCTransfer *)transfer;
+- (NSUInteger)_numberOfSlotsForClass:(Class)class connection:(WCServerConnection *)connection;
+- (NSUInteger)_queuePolicyForConnection:(WCServerConnection *)connection;
 
 - (NSString *)_statusForTransfer:(WCTransfer *)transfer;
+- (NSString *)_toolTipForTransfer:(WCTransfer *)transfer;
+- (void)_sampleStats;
 
 - (void)_requestNextTransferForConnection:(WCServerConnection *)connection;
 - (void)_requestTransfer:(WCTransfer *)transfer;
 - (void)_startTransfer:(WCTransfer *)transfer first:(BOOL)first;
 - (void)_queueTransfer:(WCTransfer *)transfer;
+- (void)_locallyQueueTransfer:(WCTransfer *)transfer;
+- (void)_rebuildQueue;
 - (void)_createRemainingDirectoriesForTransfer:(WCTransfer *)transfer;
 - (void)_invalidateTransfersForConnection:(WCServerConnection *)connection;
+- (void)_saveTransfer:(WCTransfer *)transfer;
 - (void)_saveTransfers;
+- (void)_finishFile:(WCFile *)file forTransfer:(WCTransfer *)transfer;
 - (void)_finishTransfer:(WCTransfer *)transfer;
 - (void)_removeTransfer:(WCTransfer *)transfer;
+- (void)_reportSyncForTransfer:(WCTransfer *)transfer;
 
 - (BOOL)_downloadFiles:(NSArray *)file toFolder:(NSString *)destination;
 - (BOOL)_downloadFile:(WCFile *)file toFolder:(NSString *)destination;
+- (BOOL)_downloadFile:(WCFile *)file toFolder:(NSString *)destination sync:(BOOL)sync dryRun:(BOOL)dryRun;
 - (BOOL)_uploadPaths:(NSArray *)paths toFolder:(WCFile *)destination;
 - (BOOL)_uploadPath:(NSString *)path toFolder:(WCFile *)destination;
+- (BOOL)_uploadPath:(NSString *)path toFolder:(WCFile *)destination sync:(BOOL)sync dryRun:(BOOL)dryRun;
 
 - (WCTransferConnection *)_transferConnectionForTransfer:(WCTransfer *)transfer;
+- (WCTransferConnection *)_connectedTransferConnectionForTransfer:(WCTransfer *)transfer error:(WCError **)error;
+- (void)_releaseTransferConnection:(WCTransferConnection *)connection;
+- (void)_verifyPartialFile:(WCFile *)file forTransfer:(WCTransfer *)transfer;
 - (BOOL)_sendDownloadFileMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file error:(WCError **)error;
-- (BOOL)_sendUploadFileMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file error:(WCError **)error;
+- (BOOL)_sendUploadFileMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file transaction:(WIP7UInt32)transaction error:(WCError **)error;
 - (BOOL)_sendUploadMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file dataLength:(WIFileOffset)dataLength rsrcLength:(WIFileOffset)rsrcLength error:(WCError **)error;
+- (NSArray *)_sendPipelinedMessages:(NSArray *)messages onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
 - (BOOL)_createRemainingDirectoriesOnConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
+- (BOOL)_deleteReplacedFilesOnConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
 - (BOOL)_connectConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
 - (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageName:(NSString *)messageName error:(WCError **)error;
+- (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageName:(NSString *)messageName orIdle:(BOOL)idle error:(WCError **)error;
+- (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageNames:(NSSet *)messageNames orIdle:(BOOL)idle error:(WCError **)error;
+- (BOOL)_runDownloadOfFile:(WCFile *)file withMessage:(WIP7Message *)message onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
 - (void)_runDownload:(WCTransfer *)transfer;
+- (void)_resumeDownload:(WCTransfer *)transfer;
+- (void)_runDownloadStream:(WCTransfer *)transfer;
+- (void)_requestDownloadStream:(_WCTransfersStream *)stream forTransfer:(WCTransfer *)transfer;
+- (void)_resumeDownloadStream:(WCTransfer *)transfer stream:(_WCTransfersStream *)stream;
+- (void)_finishDownloadStream:(_WCTransfersStream *)stream forTransfer:(WCTransfer *)transfer error:(WCError *)error;
+- (BOOL)_runUploadOfFile:(WCFile *)file withMessage:(WIP7Message *)message onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error;
 - (void)_runUpload:(WCTransfer *)transfer;
+- (void)_resumeUpload:(WCTransfer *)transfer;
 
 @end
 
@@ -258,6 +347,28 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (BOOL)_validatePriority {
+	NSEnumerator	*enumerator;
+	NSArray			*transfers;
+	WCTransfer		*transfer;
+	
+	transfers = [self _selectedTransfers];
+	
+	if([transfers count] == 0)
+		return NO;
+	
+	enumerator = [transfers objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		if([transfer state] == WCTransferFinished)
+			return NO;
+	}
+	
+	return YES;
+}
+
+
+
 - (void)_themeDidChange {
 	NSDictionary		*theme;
 	
@@ -358,22 +469,6 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
-- (WCTransfer *)_transferWithState:(WCTransferState)state class:(Class)class {
-	NSEnumerator		*enumerator;
-	WCTransfer			*transfer;
-
-	enumerator = [_transfers objectEnumerator];
-
-	while((transfer = [enumerator nextObject])) {
-		if([transfer state] == state && [transfer class] == class)
-			return transfer;
-	}
-
-	return NULL;
-}
-
-
-
 - (WCTransfer *)_transferWithTransaction:(NSUInteger)transaction {
 	WCTransfer			*transfer;
 	NSUInteger			i, count;
@@ -409,6 +504,82 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (NSUInteger)_numberOfStreamsForTransfer:(WCTransfer *)transfer {
+	NSDictionary		*bookmark;
+	NSUInteger			streams, serverLimit, accountLimit;
+	
+	if(![transfer isFolder] || ![transfer isKindOfClass:[WCDownloadTransfer class]])
+		return 1;
+	
+	bookmark = [transfer bookmark];
+	
+	if([bookmark objectForKey:WCBookmarksTransferStreams])
+		streams = [bookmark unsignedIntegerForKey:WCBookmarksTransferStreams];
+	else
+		streams = [[WCSettings settings] integerForKey:WCTransferStreams];
+	
+	serverLimit		= [[[transfer connection] server] downloads];
+	accountLimit	= [[[transfer connection] account] transferDownloadLimit];
+	
+	if(serverLimit > 0)
+		streams = WIMin(streams, serverLimit);
+	
+	if(accountLimit > 0)
+		streams = WIMin(streams, accountLimit);
+	
+	return WIMax(1U, streams);
+}
+
+
+
+- (NSUInteger)_numberOfSlotsForClass:(Class)class connection:(WCServerConnection *)connection {
+	NSDictionary		*bookmark;
+	NSString			*key, *bookmarkKey;
+	NSUInteger			slots, serverLimit, accountLimit;
+	
+	bookmark = [connection bookmark];
+	
+	if([class isSubclassOfClass:[WCDownloadTransfer class]]) {
+		key				= WCTransferDownloadSlots;
+		bookmarkKey		= WCBookmarksTransferDownloadSlots;
+		serverLimit		= [[connection server] downloads];
+		accountLimit	= [[connection account] transferDownloadLimit];
+	} else {
+		key				= WCTransferUploadSlots;
+		bookmarkKey		= WCBookmarksTransferUploadSlots;
+		serverLimit		= [[connection server] uploads];
+		accountLimit	= [[connection account] transferUploadLimit];
+	}
+	
+	if([bookmark objectForKey:bookmarkKey])
+		slots = [bookmark unsignedIntegerForKey:bookmarkKey];
+	else
+		slots = [[WCSettings settings] integerForKey:key];
+	
+	if(serverLimit > 0)
+		slots = WIMin(slots, serverLimit);
+	
+	if(accountLimit > 0)
+		slots = WIMin(slots, accountLimit);
+	
+	return WIMax(1U, slots);
+}
+
+
+
+- (NSUInteger)_queuePolicyForConnection:(WCServerConnection *)connection {
+	NSDictionary		*bookmark;
+	
+	bookmark = [connection bookmark];
+	
+	if([bookmark objectForKey:WCBookmarksTransferQueuePolicy])
+		return [bookmark unsignedIntegerForKey:WCBookmarksTransferQueuePolicy];
+	
+	return [[WCSettings settings] integerForKey:WCTransferQueuePolicy];
+}
+
+
+
 #pragma mark -
 
 - (BOOL)_downloadFiles:(NSArray *)files toFolder:(NSString *)destination {
@@ -485,6 +656,12 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 - (BOOL)_downloadFile:(WCFile *)file toFolder:(NSString *)destination {
+	return [self _downloadFile:file toFolder:destination sync:NO dryRun:NO];
+}
+
+
+
+- (BOOL)_downloadFile:(WCFile *)file toFolder:(NSString *)destination sync:(BOOL)sync dryRun:(BOOL)dryRun {
 	NSString				*path;
 	WCDownloadTransfer		*transfer;
 	WCError					*error;
@@ -504,6 +681,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	[transfer setDestinationPath:destination];
 	[transfer setRemotePath:[file path]];
 	[transfer setName:[file name]];
+	[transfer setSync:sync];
+	[transfer setDryRun:dryRun];
 	
 	if([file type] == WCFileFile) {
 		if(![path hasSuffix:WCTransfersFileExtension])
@@ -532,15 +711,15 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	[_transfers addObject:transfer];
 	
-	[self _saveTransfers];
+	[self _saveTransfer:transfer];
 
 	count = [self _numberOfWorkingTransfersOfClass:[transfer class] connection:[file connection]];
 
 	if(count == 1)
 		[self showWindow:self];
 	
-	if(count > 1 && [[WCSettings settings] boolForKey:WCQueueTransfers])
-		[transfer setState:WCTransferLocallyQueued];
+	if(count > [self _numberOfSlotsForClass:[transfer class] connection:[transfer connection]] && [[WCSettings settings] boolForKey:WCQueueTransfers])
+		[self _locallyQueueTransfer:transfer];
 	else
 		[self _requestTransfer:transfer];
 	
@@ -621,6 +800,12 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 - (BOOL)_uploadPath:(NSString *)path toFolder:(WCFile *)destination {
+	return [self _uploadPath:path toFolder:destination sync:NO dryRun:NO];
+}
+
+
+
+- (BOOL)_uploadPath:(NSString *)path toFolder:(WCFile *)destination sync:(BOOL)sync dryRun:(BOOL)dryRun {
 	NSDirectoryEnumerator	*enumerator;
 	NSString				*eachPath, *remotePath, *localPath, *serverPath;
 	WCTransfer				*transfer;
@@ -643,6 +828,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	[transfer setLocalPath:path];
 	[transfer setName:[path lastPathComponent]];
 	[transfer setRemotePath:remotePath];
+	[transfer setSync:sync];
+	[transfer setDryRun:dryRun];
 	
 	if([[NSFileManager defaultManager] directoryExistsAtPath:path]) {
 		[transfer setFolder:YES];
@@ -694,15 +881,15 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	[_transfers addObject:transfer];
 	
-	[self _saveTransfers];
+	[self _saveTransfer:transfer];
 
 	count = [self _numberOfWorkingTransfersOfClass:[transfer class] connection:[destination connection]];
 	
 	if(count == 1)
 		[self showWindow:self];
 	
-	if(count > 1 && [[WCSettings settings] boolForKey:WCQueueTransfers])
-		[transfer setState:WCTransferLocallyQueued];
+	if(count > [self _numberOfSlotsForClass:[transfer class] connection:[transfer connection]] && [[WCSettings settings] boolForKey:WCQueueTransfers])
+		[self _locallyQueueTransfer:transfer];
 	else
 		[self _requestTransfer:transfer];
 	
@@ -730,10 +917,21 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	switch(state) {
 		case WCTransferLocallyQueued:
+			if([transfer priority] != 0) {
+				return [NSSWF:NSLS(@"Queued, priority %ld", @"Transfer locally queued (priority)"),
+					(long) [transfer priority]];
+			}
+			
 			return NSLS(@"Queued", @"Transfer locally queued");
 			break;
 			
 		case WCTransferWaiting:
+			if([_transferPool hasPendingJobForTransfer:transfer]) {
+				return [NSSWF:NSLS(@"Waiting for a transfer worker, %lu of %lu busy", @"Transfer waiting for worker (busy, size)"),
+					(unsigned long) [_transferPool numberOfBusyWorkers],
+					(unsigned long) [_transferPool size]];
+			}
+			
 			return NSLS(@"Waiting", @"Transfer waiting");
 			break;
 			
@@ -752,7 +950,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			
 		case WCTransferCreatingDirectories:
 			return [NSSWF:NSLS(@"Creating directories... %lu", @"Transfer directories (directories"),
-				[[transfer createdDirectories] count]];
+				[transfer numberOfCreatedDirectories]];
 			break;
 			
 		case WCTransferRunning:
@@ -853,6 +1051,12 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			break;
 			
 		case WCTransferFinished:
+			if([transfer isDryRun]) {
+				return [NSSWF:NSLS(@"Sync preview, %lu changed files, %@", @"Transfer sync preview finished (files, size)"),
+					(unsigned long) [[transfer syncChanges] count],
+					[_sizeFormatter stringFromSize:[transfer syncSize]]];
+			}
+			
 			transferred		= [transfer dataTransferred] + [transfer rsrcTransferred];
 			interval		= [transfer accumulatedTime];
 			speed			= (interval > 0.0) ? [transfer actualTransferred] / interval : 0.0;
@@ -879,29 +1083,122 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (NSString *)_toolTipForTransfer:(WCTransfer *)transfer {
+	NSMutableString		*toolTip;
+	NSString			*format, *server;
+	NSTimeInterval		readStallTime, writeStallTime;
+	WCStatsSummary		summary;
+	
+	toolTip = [[[transfer name] mutableCopy] autorelease];
+	
+	[toolTip appendFormat:@"\n%@", [self _statusForTransfer:transfer]];
+	
+	readStallTime	= [transfer readStallTime];
+	writeStallTime	= [transfer writeStallTime];
+	
+	if(readStallTime > 0.0 || writeStallTime > 0.0) {
+		if([transfer isKindOfClass:[WCDownloadTransfer class]])
+			format = NSLS(@"\nWaited %@ for network, %@ for disk", @"Download transfer tooltip (read stall, write stall)");
+		else
+			format = NSLS(@"\nWaited %@ for disk, %@ for network", @"Upload transfer tooltip (read stall, write stall)");
+		
+		[toolTip appendFormat:format,
+			[_timeIntervalFormatter stringFromTimeInterval:readStallTime],
+			[_timeIntervalFormatter stringFromTimeInterval:writeStallTime]];
+	}
+	
+	if([transfer isKindOfClass:[WCUploadTransfer class]] && [transfer chunkSize] > 0) {
+		[toolTip appendFormat:NSLS(@"\nSending %@ chunks, %@ spent framing", @"Upload transfer tooltip (chunk size, framing time)"),
+			[_sizeFormatter stringFromSize:[transfer chunkSize]],
+			[_timeIntervalFormatter stringFromTimeInterval:[transfer framingTime]]];
+	}
+	
+	if([_connectionPool hits] > 0 || [_connectionPool misses] > 0) {
+		[toolTip appendFormat:NSLS(@"\nReused %lu of %lu connections, saved %@", @"Transfer tooltip (connection pool hits, total, handshake time saved)"),
+			(unsigned long) [_connectionPool hits],
+			(unsigned long) ([_connectionPool hits] + [_connectionPool misses]),
+			[_timeIntervalFormatter stringFromTimeInterval:[_connectionPool handshakeTimeSaved]]];
+	}
+	
+	summary = [[WCStats stats] summaryForTransfer:[transfer identifier] interval:60.0];
+	
+	if(summary.bytes > 0) {
+		[toolTip appendFormat:NSLS(@"\nLast minute: %@/s average, %@/s peak, stalled %@", @"Transfer tooltip (average speed, peak speed, stall time)"),
+			[_sizeFormatter stringFromSize:summary.averageSpeed],
+			[_sizeFormatter stringFromSize:summary.peakSpeed],
+			[_timeIntervalFormatter stringFromTimeInterval:summary.stallTime]];
+	}
+	
+	server = [[[transfer connection] URL] hostpair];
+	
+	if(server) {
+		summary = [[WCStats stats] summaryForServer:server interval:3600.0];
+		
+		if(summary.bytes > 0 || summary.reconnects > 0) {
+			[toolTip appendFormat:NSLS(@"\nServer last hour: %@/s average, %@/s peak, %lu reconnects", @"Transfer tooltip (average speed, peak speed, reconnects)"),
+				[_sizeFormatter stringFromSize:summary.averageSpeed],
+				[_sizeFormatter stringFromSize:summary.peakSpeed],
+				(unsigned long) summary.reconnects];
+		}
+		
+		if(summary.handshakes > 0) {
+			[toolTip appendFormat:NSLS(@"\nTransfer logins took %.0f ms on average", @"Transfer tooltip (handshake time)"),
+				summary.handshakeTime * 1000.0 / summary.handshakes];
+		}
+	}
+	
+	return toolTip;
+}
+
+
+
+- (void)_sampleStats {
+	NSEnumerator		*enumerator;
+	WCTransfer			*transfer;
+	WIFileOffset		transferred;
+	NSTimeInterval		stallTime;
+	
+	enumerator = [_transfers objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		[transfer getStatsTransferred:&transferred stallTime:&stallTime];
+		
+		if(transferred > 0 || stallTime > 0.0) {
+			[[WCStats stats] addTransferredBytes:transferred
+									   stallTime:stallTime
+									 forTransfer:[transfer identifier]
+										  server:[[[transfer connection] URL] hostpair]];
+		}
+	}
+}
+
+
+
 #pragma mark -
 
 - (void)_requestNextTransferForConnection:(WCServerConnection *)connection {
-	WCTransfer		*transfer = NULL;
-	NSUInteger		downloads, uploads;
+	NSArray			*classes;
+	WCTransfer		*transfer;
+	Class			class;
+	NSUInteger		i, working, slots;
+	BOOL			queue;
 	
-	if(![[WCSettings settings] boolForKey:WCQueueTransfers]) {
-		transfer	= [self _transferWithState:WCTransferLocallyQueued];
-	} else {
-		downloads	= [self _numberOfWorkingTransfersOfClass:[WCDownloadTransfer class] connection:connection];
-		uploads		= [self _numberOfWorkingTransfersOfClass:[WCUploadTransfer class] connection:connection];
-		
-		if(downloads == 0 && uploads == 0)
-			transfer = [self _transferWithState:WCTransferLocallyQueued];
-		else if(downloads == 0)
-			transfer = [self _transferWithState:WCTransferLocallyQueued class:[WCDownloadTransfer class]];
-		else if(uploads == 0)
-			transfer = [self _transferWithState:WCTransferLocallyQueued class:[WCUploadTransfer class]];
+	classes		= [NSArray arrayWithObjects:[WCDownloadTransfer class], [WCUploadTransfer class], NULL];
+	queue		= [[WCSettings settings] boolForKey:WCQueueTransfers];
+	
+	for(i = 0; i < [classes count]; i++) {
+		class		= [classes objectAtIndex:i];
+		working		= [self _numberOfWorkingTransfersOfClass:class connection:connection];
+		slots		= queue ? [self _numberOfSlotsForClass:class connection:connection] : NSUIntegerMax;
 		
+		while(working < slots && (transfer = [_queue firstTransferForConnection:connection class:class])) {
+			[_queue removeTransfer:transfer];
+			
+			[self _requestTransfer:transfer];
+			
+			working++;
+		}
 	}
-
-	if(transfer)
-		[self _requestTransfer:transfer];
 }
 
 
@@ -913,8 +1210,16 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 	[_errorQueue dismissErrorWithIdentifier:[transfer identifier]];
 	
+	[transfer setRequestTime:WCTimeInterval()];
+	
 	if([transfer isFolder]) {
 		[transfer setState:WCTransferListing];
+		[transfer setListing:YES];
+		
+		if([transfer isSync]) {
+			[transfer removeAllSyncChanges];
+			[transfer removeAllReplacedPaths];
+		}
 		
 		if([transfer isKindOfClass:[WCDownloadTransfer class]]) {
 			path = [transfer remotePath];
@@ -922,9 +1227,11 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			path = [[transfer destinationPath] stringByAppendingPathComponent:
 				[[transfer localPath] lastPathComponent]];
 
-			message = [WIP7Message messageWithName:@"wired.transfer.upload_directory" spec:WCP7Spec];
-			[message setString:[transfer remotePath] forName:@"wired.file.path"];
-			[[transfer connection] sendMessage:message fromObserver:self selector:@selector(wiredTransferUploadDirectoryReply:)];
+			if(![transfer isDryRun]) {
+				message = [WIP7Message messageWithName:@"wired.transfer.upload_directory" spec:WCP7Spec];
+				[message setString:[transfer remotePath] forName:@"wired.file.path"];
+				[[transfer connection] sendMessage:message fromObserver:self selector:@selector(wiredTransferUploadDirectoryReply:)];
+			}
 		}
 
 		message = [WIP7Message messageWithName:@"wired.file.list_directory" spec:WCP7Spec];
@@ -944,14 +1251,37 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 - (void)_startTransfer:(WCTransfer *)transfer first:(BOOL)first {
+	NSUInteger		streams;
+	
 	[[transfer connection] triggerEvent:WCEventsTransferStarted info1:transfer];
+	
+	streams = [self _numberOfStreamsForTransfer:transfer];
+	
+	if(streams > 1)
+		[self _createRemainingDirectoriesForTransfer:transfer];
 
 	if(![transfer isTerminating])
 		[transfer setState:WCTransferWaiting];
 	
 	[NSObject cancelPreviousPerformRequestsWithTarget:self selector:@selector(_queueTransfer:) object:transfer]; 
 
-	[WIThread detachNewThreadSelector:@selector(transferThread:) toTarget:self withObject:transfer];
+	if(streams > 1) {
+		if([transfer transferConnection]) {
+			[self _releaseTransferConnection:[transfer transferConnection]];
+			
+			[transfer setTransferConnection:NULL];
+		}
+		
+		streams = WIMax(1U, WIMin(streams, [transfer numberOfUntransferredFiles]));
+		
+		while([transfer beginStreamWithLimit:streams])
+			[_transferPool addJobWithTarget:self selector:@selector(_runDownloadStream:) transfer:transfer];
+	} else {
+		if([transfer isKindOfClass:[WCDownloadTransfer class]])
+			[_transferPool addJobWithTarget:self selector:@selector(_runDownload:) transfer:transfer];
+		else
+			[_transferPool addJobWithTarget:self selector:@selector(_runUpload:) transfer:transfer];
+	}
 }
 
 
@@ -964,6 +1294,30 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (void)_locallyQueueTransfer:(WCTransfer *)transfer {
+	[transfer setState:WCTransferLocallyQueued];
+	
+	[_queue addTransfer:transfer policy:[self _queuePolicyForConnection:[transfer connection]]];
+}
+
+
+
+- (void)_rebuildQueue {
+	NSEnumerator		*enumerator;
+	WCTransfer			*transfer;
+	
+	[_queue removeAllTransfers];
+	
+	enumerator = [_transfers objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		if([transfer state] == WCTransferLocallyQueued && [[transfer connection] isConnected])
+			[_queue addTransfer:transfer policy:[self _queuePolicyForConnection:[transfer connection]]];
+	}
+}
+
+
+
 - (void)_createRemainingDirectoriesForTransfer:(WCTransfer *)transfer {
 	NSArray			*directories;
 	WIP7Message		*message;
@@ -1004,6 +1358,9 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	NSEnumerator		*enumerator;
 	WCTransfer			*transfer;
 	
+	[_connectionPool removeConnectionsForConnection:connection];
+	[_queue removeTransfersForConnection:connection];
+	
 	enumerator = [_transfers objectEnumerator];
 	
 	while((transfer = [enumerator nextObject])) {
@@ -1018,6 +1375,13 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (void)_saveTransfer:(WCTransfer *)transfer {
+	if(![transfer isWorking])
+		[_journal writeTransfer:transfer];
+}
+
+
+
 - (void)_saveTransfers {
 	NSEnumerator		*enumerator;
 	NSMutableArray		*transfers;
@@ -1031,66 +1395,100 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			[transfers addObject:transfer];
 	}
 	
-	[[WCSettings settings] setObject:[NSKeyedArchiver archivedDataWithRootObject:transfers] forKey:WCTransferList];
+	[_journal compactWithTransfers:transfers];
 }
 
 
 
-- (void)_finishTransfer:(WCTransfer *)transfer {
+- (void)_finishFile:(WCFile *)file forTransfer:(WCTransfer *)transfer {
 	NSString			*path, *newPath;
 	NSDictionary		*dictionary;
+	
+	if([transfer isKindOfClass:[WCDownloadTransfer class]]) {
+		path		= [file transferLocalPath];
+		newPath		= [path stringByDeletingPathExtension];
+		
+		[[NSFileManager defaultManager] removeExtendedAttributeForName:WCTransfersFileExtendedAttributeName atPath:path error:NULL];
+		[WCTransferManifest removeManifestAtPath:path];
+		
+		if([transfer isSync])
+			[[NSFileManager defaultManager] removeFileAtPath:newPath handler:NULL];
+		
+		[[NSFileManager defaultManager] movePath:path toPath:newPath handler:NULL];
+		
+		[transfer setLocalPath:newPath];
+		
+		if([file isExecutable]) {
+			dictionary = [NSDictionary dictionaryWithObject:[NSNumber numberWithInt:0755] forKey:NSFilePosixPermissions];
+			
+			[[NSFileManager defaultManager] changeFileAttributes:dictionary atPath:newPath];
+		}
+	}
+	
+	[transfer addTransferredFile:file];
+	[transfer removeUntransferredFile:file];
+}
+
+
+
+- (void)_finishTransfer:(WCTransfer *)transfer {
 	WCFile				*file;
 	WCTransferState		state;
-	BOOL				download, next = YES;
+	BOOL				download, finished, next = YES;
 	
 	[transfer retain];
 	
 	file		= [[transfer firstUntransferredFile] retain];
-	path		= [file transferLocalPath];
 	download	= [transfer isKindOfClass:[WCDownloadTransfer class]];
 	
-	if((download && [file dataTransferred] + [file rsrcTransferred] >= [file dataSize] + [file rsrcSize]) ||
-	   (!download && [file dataTransferred] + [file rsrcTransferred] >= [file uploadDataSize] + [file uploadRsrcSize])) {
-		if([transfer isKindOfClass:[WCDownloadTransfer class]]) {
-			newPath = [path stringByDeletingPathExtension];
-			
-			[[NSFileManager defaultManager] removeExtendedAttributeForName:WCTransfersFileExtendedAttributeName atPath:path error:NULL];
-			[[NSFileManager defaultManager] movePath:path toPath:newPath handler:NULL];
-			
-			[transfer setLocalPath:newPath];
-			path = newPath;
-			
-			if([file isExecutable]) {
-				dictionary = [NSDictionary dictionaryWithObject:[NSNumber numberWithInt:0755] forKey:NSFilePosixPermissions];
-				
-				[[NSFileManager defaultManager] changeFileAttributes:dictionary atPath:path];
-			}
-		}
+	if(!file)
+		finished = YES;
+	else if(download)
+		finished = ([file dataTransferred] + [file rsrcTransferred] >= [file dataSize] + [file rsrcSize] &&
+					[[NSFileManager defaultManager] fileExistsAtPath:[file transferLocalPath]]);
+	else
+		finished = ([file dataTransferred] + [file rsrcTransferred] >= [file uploadDataSize] + [file uploadRsrcSize]);
+	
+	if(finished && file)
+		[self _finishFile:file forTransfer:transfer];
+	
+	if(finished && [transfer numberOfUntransferredFiles] == 0 && [transfer isListing] && ![transfer isTerminating]) {
+		if([transfer transferConnection])
+			[self _releaseTransferConnection:[transfer transferConnection]];
 		
-		if(file) {
-			[transfer addTransferredFile:file];
-			[transfer removeUntransferredFile:file];
-		}
+		[transfer setTransferConnection:NULL];
+		[transfer setState:WCTransferListing];
 		
-		if([transfer numberOfUntransferredFiles] == 0) {
-			[[transfer transferConnection] disconnect];
-			[transfer setTransferConnection:NULL];
-			[transfer setState:WCTransferFinished];
-			[[transfer progressIndicator] setDoubleValue:1.0];
-			
-			if([[WCSettings settings] boolForKey:WCRemoveTransfers])
-				[self _removeTransfer:transfer];
+		[_transfersTableView setNeedsDisplay:YES];
+		
+		next = NO;
+	}
+	else if(finished && [transfer numberOfUntransferredFiles] == 0) {
+		if([transfer transferConnection])
+			[self _releaseTransferConnection:[transfer transferConnection]];
+		
+		[transfer setTransferConnection:NULL];
+		[transfer setState:WCTransferFinished];
+		[[transfer progressIndicator] setDoubleValue:1.0];
+		
+		if([[WCSettings settings] boolForKey:WCTransferBenchmarks])
+			[[[transfer connection] console] log:@"%@", [[WCTransferBenchmark benchmark] recordTransfer:transfer]];
+		
+		if([[WCSettings settings] boolForKey:WCRemoveTransfers])
+			[self _removeTransfer:transfer];
+		else
+			[self _saveTransfer:transfer];
 
-			[_transfersTableView reloadData];
+		[_transfersTableView reloadData];
 
-			[self _validate];
+		[self _validate];
 
-			[[transfer connection] triggerEvent:WCEventsTransferFinished info1:transfer];
-		} else {
-			[self _startTransfer:transfer first:NO];
+		[[transfer connection] triggerEvent:WCEventsTransferFinished info1:transfer];
+	}
+	else if((finished || [transfer isListing]) && ![transfer isTerminating]) {
+		[self _startTransfer:transfer first:NO];
 
-			next = NO;
-		}
+		next = NO;
 	} else {
 		[[transfer transferConnection] disconnect];
 		[transfer setTransferConnection:NULL];
@@ -1114,6 +1512,9 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			[transfer setState:WCTransferStopped];
 		}
 		
+		if(state != WCTransferRemoving)
+			[self _saveTransfer:transfer];
+		
 		[_transfersTableView reloadData];
 		
 		[self _validate];
@@ -1143,6 +1544,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	   [[WCSettings settings] boolForKey:WCAutoReconnect] &&
 	   ([connection isConnected] || [connection isAutoReconnecting] || [connection willAutoReconnect]) &&
 	   [transfer actualTransferred] > 0) {
+		[[WCStats stats] addReconnectForTransfer:[transfer identifier] server:[[connection URL] hostpair]];
+		
 		[self performSelector:@selector(_requestTransfer:) withObject:transfer afterDelay:2.0];
 	}
 }
@@ -1152,23 +1555,144 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 - (void)_removeTransfer:(WCTransfer *)transfer {
 	[[transfer progressIndicator] removeFromSuperview];
 
-	[_transfers removeObject:transfer];
+	[[WCStats stats] removeSeriesForTransfer:[transfer identifier]];
 
-	[self _saveTransfers];
+	[_queue removeTransfer:transfer];
+	[_journal removeTransfer:transfer];
+	[_transfers removeObject:transfer];
 }
 
 
 
-#pragma mark -
-
-- (WCTransferConnection *)_transferConnectionForTransfer:(WCTransfer *)transfer {
-	WCTransferConnection		*connection;
+- (void)_reportSyncForTransfer:(WCTransfer *)transfer {
+	NSEnumerator		*enumerator;
+	NSMutableString		*report;
+	NSString			*change;
+	WCFile				*file;
 	
-	connection = [WCTransferConnection connectionWithTransfer:transfer];
-	[connection setURL:[[transfer connection] URL]];
-	[connection setBookmark:[[transfer connection] bookmark]];
+	if([transfer isKindOfClass:[WCUploadTransfer class]]) {
+		file = [transfer firstUntransferredFile];
+		
+		while(file) {
+			if(![transfer containsReplacedPath:[file path]]) {
+				[transfer addSyncChange:[NSSWF:@"%@: %@", NSLS(@"New", @"Sync change"), [file path]]
+								   size:[file uploadDataSize] + [file uploadRsrcSize]];
+			}
+			
+			file = [transfer untransferredFileAfterFile:file];
+		}
+	}
 	
-	return connection;
+	if([transfer isDryRun]) {
+		report = [NSMutableString stringWithFormat:NSLS(@"Sync preview of \u201c%@\u201d: %lu changed files, %@", @"Sync report (name, files, size)"),
+			[transfer name],
+			(unsigned long) [[transfer syncChanges] count],
+			[_sizeFormatter stringFromSize:[transfer syncSize]]];
+	} else {
+		report = [NSMutableString stringWithFormat:NSLS(@"Sync of \u201c%@\u201d: %lu changed files, %@", @"Sync report (name, files, size)"),
+			[transfer name],
+			(unsigned long) [[transfer syncChanges] count],
+			[_sizeFormatter stringFromSize:[transfer syncSize]]];
+	}
+	
+	enumerator = [[transfer syncChanges] objectEnumerator];
+	
+	while((change = [enumerator nextObject]))
+		[report appendFormat:@"\n\t%@", change];
+	
+	[[[transfer connection] console] log:@"%@", report];
+	
+	if([transfer isDryRun]) {
+		[transfer setState:WCTransferFinished];
+		[[transfer progressIndicator] setDoubleValue:1.0];
+		
+		[self _saveTransfer:transfer];
+		[self _requestNextTransferForConnection:[transfer connection]];
+		
+		[_transfersTableView reloadData];
+		
+		[self _validate];
+	}
+}
+
+
+
+#pragma mark -
+
+- (WCTransferConnection *)_transferConnectionForTransfer:(WCTransfer *)transfer {
+	WCTransferConnection		*connection;
+	
+	connection = [WCTransferConnection connectionWithTransfer:transfer];
+	[connection setURL:[[transfer connection] URL]];
+	[connection setBookmark:[[transfer connection] bookmark]];
+	
+	return connection;
+}
+
+
+
+- (WCTransferConnection *)_connectedTransferConnectionForTransfer:(WCTransfer *)transfer error:(WCError **)error {
+	WCTransferConnection		*connection;
+	
+	connection = [_connectionPool connectionForTransfer:transfer];
+	
+	if(connection)
+		return connection;
+	
+	connection = [self _transferConnectionForTransfer:transfer];
+	
+	if(![self _connectConnection:connection forTransfer:transfer error:error])
+		return NULL;
+	
+	return connection;
+}
+
+
+
+- (void)_releaseTransferConnection:(WCTransferConnection *)connection {
+	if(![_connectionPool addConnection:connection])
+		[connection disconnect];
+}
+
+
+
+- (void)_verifyPartialFile:(WCFile *)file forTransfer:(WCTransfer *)transfer {
+	WCTransferManifest		*manifest;
+	NSString				*path;
+	WIFileOffset			length;
+	
+	path = [file transferLocalPath];
+	
+	if([file dataTransferred] == 0) {
+		manifest = [[WCTransferManifest alloc] initWithPath:path dataSize:[file dataSize]];
+		[transfer setManifest:manifest forFile:file];
+		[manifest release];
+		
+		return;
+	}
+	
+	manifest = [WCTransferManifest manifestWithContentsOfPath:path];
+	
+	if(!manifest) {
+		[transfer setManifest:NULL forFile:file];
+		
+		return;
+	}
+	
+	length = [manifest verifyLength:[file dataTransferred]];
+	
+	if(truncate([path fileSystemRepresentation], length) < 0) {
+		[transfer setManifest:NULL forFile:file];
+		
+		return;
+	}
+	
+	if(length < [file dataTransferred]) {
+		[transfer rewindDataTransferred:[file dataTransferred] - length];
+		[file setDataTransferred:length];
+	}
+	
+	[transfer setManifest:manifest forFile:file];
 }
 
 
@@ -1186,10 +1710,11 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
-- (BOOL)_sendUploadFileMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file error:(WCError **)error {
+- (BOOL)_sendUploadFileMessageOnConnection:(WCTransferConnection *)connection forFile:(WCFile *)file transaction:(WIP7UInt32)transaction error:(WCError **)error {
 	WIP7Message		*message;
 	
 	message = [WIP7Message messageWithName:@"wired.transfer.upload_file" spec:WCP7Spec];
+	[message setUInt32:transaction forName:@"wired.transaction"];
 	[message setString:[file path] forName:@"wired.file.path"];
 	[message setUInt64:[file uploadDataSize] forName:@"wired.transfer.data_size"];
 	[message setUInt64:[file uploadRsrcSize] forName:@"wired.transfer.rsrc_size"];
@@ -1220,11 +1745,74 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (NSArray *)_sendPipelinedMessages:(NSArray *)messages onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
+	NSMutableArray		*replies;
+	NSSet				*replyNames;
+	WIP7Message			*message;
+	NSUInteger			i, count, pending;
+	WIP7UInt32			transaction;
+	
+	count		= [messages count];
+	replies		= [NSMutableArray arrayWithCapacity:count];
+	replyNames	= [NSSet setWithObjects:@"wired.okay", @"wired.error", NULL];
+	pending		= 0;
+	
+	for(i = 0; i < count; i++)
+		[replies addObject:[NSNull null]];
+	
+	i = 0;
+	
+	while(i < count || pending > 0) {
+		while(i < count && pending < WCTransfersPipelineWindow) {
+			message = [messages objectAtIndex:i++];
+			[message setUInt32:i forName:@"wired.transaction"];
+			
+			if(![connection writeMessage:message timeout:30.0 error:error])
+				return NULL;
+			
+			pending++;
+		}
+		
+		message = [self _runConnection:connection
+						   forTransfer:transfer
+			untilReceivingMessageNames:replyNames
+								orIdle:NO
+								 error:error];
+		
+		if(!message)
+			return NULL;
+		
+		if(![message getUInt32:&transaction forName:@"wired.transaction"]) {
+			if([[message name] isEqualToString:@"wired.error"]) {
+				if(error)
+					*error = [WCError errorWithWiredMessage:message];
+				
+				return NULL;
+			}
+			
+			continue;
+		}
+		
+		if(transaction == 0 || transaction > i || [replies objectAtIndex:transaction - 1] != [NSNull null])
+			continue;
+		
+		[replies replaceObjectAtIndex:transaction - 1 withObject:message];
+		
+		pending--;
+	}
+	
+	return replies;
+}
+
+
+
 - (BOOL)_createRemainingDirectoriesOnConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
-	NSArray			*directories;
-	WIP7Message		*message;
-	WCFile			*directory;
-	NSUInteger		i, count;
+	NSArray					*directories, *replies;
+	NSMutableArray			*messages;
+	WIP7Message				*message;
+	WCFile					*directory;
+	WCError					*directoryError;
+	NSUInteger				i, count;
 	
 	directories = [transfer uncreatedDirectories];
 	count = [directories count];
@@ -1235,37 +1823,48 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		[self performSelectorOnMainThread:@selector(_validate)];
 	}
 	
-	for(i = 0; i < count; i++) {
-		directory = [directories objectAtIndex:i];
-		
-		if([transfer isKindOfClass:[WCDownloadTransfer class]]) {
-			[[NSFileManager defaultManager] createDirectoryAtPath:[[directories objectAtIndex:i] transferLocalPath]];
+	if([transfer isKindOfClass:[WCDownloadTransfer class]]) {
+		for(i = 0; i < count; i++) {
+			directory = [directories objectAtIndex:i];
+			
+			[[NSFileManager defaultManager] createDirectoryAtPath:[directory transferLocalPath]];
 			
 			[transfer addCreatedDirectory:directory];
 			[transfer removeUncreatedDirectory:directory];
-			
-			count--;
-			i--;
-		} else {
+		}
+	} else {
+		messages = [NSMutableArray arrayWithCapacity:count];
+		
+		for(i = 0; i < count; i++) {
 			message = [WIP7Message messageWithName:@"wired.transfer.upload_directory" spec:WCP7Spec];
-			[message setString:[directory path] forName:@"wired.file.path"];
-
-			if(![connection writeMessage:message timeout:30.0 error:error])
-				return NO;
+			[message setString:[[directories objectAtIndex:i] path] forName:@"wired.file.path"];
 			
-			message = [self _runConnection:connection
-							   forTransfer:transfer
-				 untilReceivingMessageName:@"wired.okay"
-									 error:error];
+			[messages addObject:message];
+		}
+		
+		replies = [self _sendPipelinedMessages:messages onConnection:connection forTransfer:transfer error:error];
+		
+		if(!replies)
+			return NO;
+		
+		for(i = 0; i < count; i++) {
+			directory	= [directories objectAtIndex:i];
+			message		= [replies objectAtIndex:i];
 			
-			if(!message)
-				return NO;
+			if([[message name] isEqualToString:@"wired.error"]) {
+				directoryError = [WCError errorWithWiredMessage:message];
+				
+				if([directoryError code] != WCWiredProtocolFileExists) {
+					[_errorQueue performSelectorOnMainThread:@selector(showError:) withObject:directoryError];
+					
+					[transfer removeUncreatedDirectory:directory];
+					
+					continue;
+				}
+			}
 			
 			[transfer addCreatedDirectory:directory];
 			[transfer removeUncreatedDirectory:directory];
-			
-			count--;
-			i--;
 		}
 	}
 	
@@ -1276,25 +1875,62 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (BOOL)_deleteReplacedFilesOnConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
+	NSArray					*paths, *replies;
+	NSMutableArray			*messages;
+	WIP7Message				*message;
+	WCError					*deleteError;
+	NSUInteger				i, count;
+	
+	paths		= [transfer replacedPaths];
+	count		= [paths count];
+	messages	= [NSMutableArray arrayWithCapacity:count];
+	
+	for(i = 0; i < count; i++) {
+		message = [WIP7Message messageWithName:@"wired.file.delete" spec:WCP7Spec];
+		[message setString:[paths objectAtIndex:i] forName:@"wired.file.path"];
+		
+		[messages addObject:message];
+	}
+	
+	replies = [self _sendPipelinedMessages:messages onConnection:connection forTransfer:transfer error:error];
+	
+	if(!replies)
+		return NO;
+	
+	for(i = 0; i < count; i++) {
+		message = [replies objectAtIndex:i];
+		
+		if([[message name] isEqualToString:@"wired.error"]) {
+			deleteError = [WCError errorWithWiredMessage:message];
+			
+			if([deleteError code] != WCWiredProtocolFileNotFound) {
+				[_errorQueue performSelectorOnMainThread:@selector(showError:) withObject:deleteError];
+				
+				[transfer removeUntransferredFile:[WCFile fileWithFile:[paths objectAtIndex:i] connection:[transfer connection]]];
+			}
+		}
+	}
+	
+	[transfer removeAllReplacedPaths];
+	
+	return YES;
+}
+
+
+
 - (BOOL)_connectConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
 	WIP7Message		*message;
 	
 	if(![connection connectWithTimeout:30.0 error:error])
 		return NO;
 	
+	message = [connection loginMessage];
+	[message setUInt32:WCTransfersLoginTransaction forName:@"wired.transaction"];
+	
 	if(![connection writeMessage:[connection clientInfoMessage] timeout:30.0 error:error] ||
 	   ![connection writeMessage:[connection setNickMessage] timeout:30.0 error:error] ||
-	   ![connection writeMessage:[connection setStatusMessage] timeout:30.0 error:error] ||
-	   ![connection writeMessage:[connection setIconMessage] timeout:30.0 error:error] ||
-	   ![connection writeMessage:[connection loginMessage] timeout:30.0 error:error])
-		return NO;
-	
-	message = [self _runConnection:connection
-					   forTransfer:transfer
-		 untilReceivingMessageName:@"wired.account.privileges"
-							 error:error];
-	
-	if(!message)
+	   ![connection writeMessage:message timeout:30.0 error:error])
 		return NO;
 	
 	return YES;
@@ -1303,12 +1939,31 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 - (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageName:(NSString *)messageName error:(WCError **)error {
+	return [self _runConnection:connection forTransfer:transfer untilReceivingMessageName:messageName orIdle:NO error:error];
+}
+
+
+
+- (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageName:(NSString *)messageName orIdle:(BOOL)idle error:(WCError **)error {
+	return [self _runConnection:connection
+					forTransfer:transfer
+	 untilReceivingMessageNames:[NSSet setWithObject:messageName]
+						 orIdle:idle
+						  error:error];
+}
+
+
+
+- (WIP7Message *)_runConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer untilReceivingMessageNames:(NSSet *)messageNames orIdle:(BOOL)idle error:(WCError **)error {
 	NSString			*name;
 	WIP7Message			*message, *reply;
 	NSInteger			code;
 	WIP7UInt32			queue, transaction;
 	
 	while([transfer isWorking]) {
+		if(idle && ![[[connection socket] socket] waitWithTimeout:0.0])
+			break;
+		
 		message = [connection readMessageWithTimeout:1.0 error:error];
 	
 		if(!message) {
@@ -1322,7 +1977,17 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		
 		name = [message name];
 		
-		if([name isEqualToString:messageName]) {
+		if([message getUInt32:&transaction forName:@"wired.transaction"] && transaction == WCTransfersLoginTransaction) {
+			if([name isEqualToString:@"wired.error"]) {
+				*error = [WCError errorWithWiredMessage:message];
+				
+				return NULL;
+			}
+			
+			continue;
+		}
+		
+		if([messageNames containsObject:name]) {
 			*error = NULL;
 			
 			return message;
@@ -1363,122 +2028,43 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
-- (void)_runDownload:(WCTransfer *)transfer {
+- (BOOL)_runDownloadOfFile:(WCFile *)file withMessage:(WIP7Message *)message onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
 	NSAutoreleasePool			*pool;
-	NSProgressIndicator			*progressIndicator;
 	NSString					*dataPath, *rsrcPath;
 	NSData						*finderInfo;
 	WIP7Socket					*socket;
-	WIP7Message					*message;
-	WCTransferConnection		*connection;
-	WCFile						*file;
-	WCError						*error;
+	WCTransferWriter			*writer;
+	WCTransferManifest			*manifest;
 	void						*buffer;
-	NSTimeInterval				time, speedTime, statsTime;
+	NSTimeInterval				time, speedTime, statsTime, CPUTime;
 	NSUInteger					i, speedBytes, statsBytes;
 	NSInteger					readBytes;
 	WIP7UInt64					dataLength, rsrcLength;
-	double						percent;
-	int							dataFD, rsrcFD, writtenBytes;
+	int							dataFD, rsrcFD;
 	BOOL						data;
-		
-	error = NULL;
-	connection = [transfer transferConnection];
-	
-	if(!connection) {
-		connection = [self _transferConnectionForTransfer:transfer];
-		
-		if(![self _connectConnection:connection forTransfer:transfer error:&error]) {
-			[transfer setState:WCTransferStopping];
-			[transfer signalTerminated];
-			
-			[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-								   withObject:transfer
-								   withObject:error];
-
-			return;
-		}
-		
-		[transfer setTransferConnection:connection];
-	}
 	
-	file				= [transfer firstUntransferredFile];
 	dataPath			= [file transferLocalPath];
 	rsrcPath			= [NSFileManager resourceForkPathForPath:dataPath];
 	speedBytes			= 0;
 	statsBytes			= 0;
 	i					= 0;
 	socket				= [connection socket];
-	speedTime			= _WCTransfersTimeInterval();
+	speedTime			= WCTimeInterval();
 	statsTime			= speedTime;
-	progressIndicator	= [transfer progressIndicator];
 	data				= YES;
 	
-	[[socket socket] setInteractive:NO];
-	
-	if(![self _createRemainingDirectoriesOnConnection:connection forTransfer:transfer error:&error]) {
-		if(![transfer isTerminating]) {
-			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
-		
-		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-							   withObject:transfer
-							   withObject:error];
-		
-		return;
-	}
-	
-	if(![self _sendDownloadFileMessageOnConnection:connection forFile:file error:&error]) {
-		if(![transfer isTerminating]) {
-			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
-		
-		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-							   withObject:transfer
-							   withObject:error];
-		
-		return;
-	}
-	
-	message = [self _runConnection:connection
-					   forTransfer:transfer
-		 untilReceivingMessageName:@"wired.transfer.download"
-							 error:&error];
-	
-	if(!message) {
-		if(![transfer isTerminating]) {
-			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
-		
-		if(error) {
-			[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-								   withObject:transfer
-								   withObject:error];
-		} else {
-			[self performSelectorOnMainThread:@selector(_finishTransfer:)
-								   withObject:transfer];
-		}
-		
-		return;
-	}
-	
 	[message getUInt64:&dataLength forName:@"wired.transfer.data"];
 	[message getUInt64:&rsrcLength forName:@"wired.transfer.rsrc"];
 	
-	dataFD = open([dataPath fileSystemRepresentation], O_WRONLY | O_APPEND | O_CREAT, 0666);
-	rsrcFD = open([rsrcPath fileSystemRepresentation], O_WRONLY | O_APPEND | O_CREAT, 0666);
+	dataFD = open([dataPath fileSystemRepresentation], O_WRONLY | O_CREAT, 0666);
+	rsrcFD = (rsrcLength > 0) ? open([rsrcPath fileSystemRepresentation], O_WRONLY | O_CREAT, 0666) : -1;
 	
-	if((dataFD < 0 || lseek(dataFD, [file dataTransferred], SEEK_SET) < 0) ||
-	   (rsrcFD < 0 || lseek(rsrcFD, [file rsrcTransferred], SEEK_SET) < 0)) {
-		error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno];
+	if((dataFD < 0 || ftruncate(dataFD, [file dataTransferred]) < 0 || lseek(dataFD, [file dataTransferred], SEEK_SET) < 0) ||
+	   (rsrcLength > 0 && (rsrcFD < 0 || lseek(rsrcFD, [file rsrcTransferred], SEEK_SET) < 0))) {
+		*error = [NSError errorWithDomain:NSPOSIXErrorDomain code:errno];
 		
-		if(![transfer isTerminating]) {
+		if(![transfer isTerminating])
 			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
 		
 		if(dataFD >= 0)
 			close(dataFD);
@@ -1486,25 +2072,37 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		if(rsrcFD >= 0)
 			close(rsrcFD);
 
-		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-							   withObject:transfer
-							   withObject:error];
-		
-		return;
+		return NO;
 	}
 	
+	writer = [[WCTransferWriter alloc] initWithDataDescriptor:dataFD
+											 rsrcDescriptor:rsrcFD
+												 bufferSize:[WCTransferWriter defaultBufferSize]
+												bufferCount:[WCTransferWriter defaultBufferCount]];
+	
+	[writer preallocateDataLength:dataLength];
+	
+	manifest = [transfer manifestForFile:file];
+	
+	if(manifest)
+		[writer setManifest:manifest];
+	
 	finderInfo = [message dataForName:@"wired.transfer.finderinfo"];
 	
 	if([finderInfo length] > 0)
 		[[NSFileManager defaultManager] setFinderInfo:finderInfo atPath:dataPath];
 	
-	if(![transfer isTerminating]) {
+	if(![transfer isTerminating] && [transfer state] != WCTransferRunning) {
 		[transfer setState:WCTransferRunning];
 		
 		[self performSelectorOnMainThread:@selector(_validate)];
 	}
 	
-	wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, 0, speedTime);
+	[transfer addSpeedBytes:0 atTime:speedTime];
+	
+	[[WCTransferScheduler scheduler] addTransfer:transfer weight:1.0];
+	
+	CPUTime = WCThreadTime();
 	
 	pool = [[NSAutoreleasePool alloc] init];
 	
@@ -1515,7 +2113,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		if(!data && rsrcLength == 0)
 			break;
 		
-		readBytes = [socket readOOBData:&buffer timeout:30.0 error:&error];
+		readBytes = [socket readOOBData:&buffer timeout:30.0 error:error];
 		
 		if(readBytes <= 0) {
 			[transfer setState:WCTransferDisconnecting];
@@ -1523,44 +2121,41 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			break;
 		}
 		
+		if(i == 0)
+			[transfer setFirstByteTime:WCTimeInterval()];
+		
 		if((data && dataLength < (NSUInteger) readBytes) || (!data && rsrcLength < (NSUInteger) readBytes)) {
-			error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
+			*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
 			
 			break;
 		}
 		
-		writtenBytes = write(data ? dataFD : rsrcFD, buffer, readBytes);
+		[[WCTransferScheduler scheduler] waitForBytes:readBytes forTransfer:transfer];
 		
-		if(writtenBytes <= 0) {
-			if(writtenBytes < 0)
-				error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
+		if(![writer writeBytes:buffer length:readBytes dataFork:data]) {
+			*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
 			
 			break;
 		}
 		
 		if(data) {
 			dataLength					-= readBytes;
-			transfer->_dataTransferred	+= readBytes;
 			file->_dataTransferred		+= readBytes;
+
+			[transfer addDataTransferred:readBytes];
 		} else {
 			rsrcLength					-= readBytes;
-			transfer->_rsrcTransferred	+= readBytes;
 			file->_rsrcTransferred		+= readBytes;
+
+			[transfer addRsrcTransferred:readBytes];
 		}
-			
-		transfer->_actualTransferred	+= readBytes;
+		
 		statsBytes						+= readBytes;
 		speedBytes						+= readBytes;
-		percent							= (transfer->_dataTransferred + transfer->_rsrcTransferred) / (double) transfer->_size;
-		time							= _WCTransfersTimeInterval();
-		
-		if(percent == 1.00 || percent - [progressIndicator doubleValue] >= 0.001)
-			[progressIndicator setDoubleValue:percent];
+		time							= WCTimeInterval();
 	
 		if(transfer->_speed == 0.0 || time - speedTime > 0.33) {
-			wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, speedBytes, speedTime);
-
-			transfer->_speed = wi_speed_calculator_speed(transfer->_speedCalculator);
+			[transfer addSpeedBytes:speedBytes atTime:speedTime];
 			
 			speedBytes = 0;
 			speedTime = time;
@@ -1579,16 +2174,134 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		}
 	}
 	
+	[[WCTransferScheduler scheduler] removeTransfer:transfer];
+	
+	if(![writer close] && !*error)
+		*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
+	
+	[transfer addReadStallTime:[writer readStallTime] writeStallTime:[writer writeStallTime]];
+	[transfer addCPUTime:WCThreadTime() - CPUTime];
+	[writer release];
+	
 	close(dataFD);
-	close(rsrcFD);
 	
-	wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, speedBytes, speedTime);
+	if(rsrcFD >= 0)
+		close(rsrcFD);
 	
-	transfer->_speed = wi_speed_calculator_speed(transfer->_speedCalculator);
+	if(manifest) {
+		[manifest write];
+		
+		[transfer setManifest:NULL forFile:file];
+	}
+	
+	[transfer addSpeedBytes:speedBytes atTime:speedTime];
 	
 	if(statsBytes > 0)
 		[[WCStats stats] addUnsignedLongLong:statsBytes forKey:WCStatsDownloaded];
+	
+	[*error retain];
+	[pool release];
+	[*error autorelease];
+	
+	return (!*error && dataLength == 0 && rsrcLength == 0);
+}
+
+
+
+- (void)_runDownload:(WCTransfer *)transfer {
+	WCTransferConnection		*connection;
+	WCError						*error;
+		
+	error = NULL;
+	connection = [transfer transferConnection];
+	
+	if(!connection) {
+		connection = [self _connectedTransferConnectionForTransfer:transfer error:&error];
+		
+		if(!connection) {
+			[transfer setState:WCTransferStopping];
+			[transfer signalTerminated];
+			
+			[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
+								   withObject:transfer
+								   withObject:error];
+
+			return;
+		}
+		
+		[transfer setTransferConnection:connection];
+	}
+	
+	[[[connection socket] socket] setInteractive:NO];
+	
+	if(![self _createRemainingDirectoriesOnConnection:connection forTransfer:transfer error:&error]) {
+		if(![transfer isTerminating])
+			[transfer setState:WCTransferDisconnecting];
+		
+		[transfer signalTerminated];
+		
+		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
+							   withObject:transfer
+							   withObject:error];
+		
+		return;
+	}
+	
+	[self _verifyPartialFile:[transfer firstUntransferredFile] forTransfer:transfer];
+	
+	if(![self _sendDownloadFileMessageOnConnection:connection forFile:[transfer firstUntransferredFile] error:&error]) {
+		if(![transfer isTerminating])
+			[transfer setState:WCTransferDisconnecting];
+		
+		[transfer signalTerminated];
+		
+		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
+							   withObject:transfer
+							   withObject:error];
+		
+		return;
+	}
+	
+	[_transferPool parkJobWithTarget:self
+							selector:@selector(_resumeDownload:)
+							transfer:transfer
+							  socket:[[connection socket] socket]];
+}
+
 
+
+- (void)_resumeDownload:(WCTransfer *)transfer {
+	WCTransferConnection		*connection;
+	WIP7Message					*message;
+	WCError						*error;
+	
+	error = NULL;
+	connection = [transfer transferConnection];
+	message = [self _runConnection:connection
+					   forTransfer:transfer
+		 untilReceivingMessageName:@"wired.transfer.download"
+							orIdle:YES
+							 error:&error];
+	
+	if(message) {
+		[self _runDownloadOfFile:[transfer firstUntransferredFile]
+					 withMessage:message
+					onConnection:connection
+					 forTransfer:transfer
+						   error:&error];
+	}
+	else if(!error && [transfer isWorking]) {
+		[_transferPool parkJobWithTarget:self
+								selector:@selector(_resumeDownload:)
+								transfer:transfer
+								  socket:[[connection socket] socket]];
+		
+		return;
+	}
+	else if(![transfer isTerminating]) {
+		[transfer setState:WCTransferDisconnecting];
+	}
+	
 	[transfer signalTerminated];
 	
 	if(error) {
@@ -1599,38 +2312,169 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		[self performSelectorOnMainThread:@selector(_finishTransfer:)
 							   withObject:transfer];
 	}
+}
+
+
+
+- (void)_runDownloadStream:(WCTransfer *)transfer {
+	_WCTransfersStream			*stream;
+	WCTransferConnection		*connection;
+	WCError						*error;
 	
-	[pool release];
+	error = NULL;
+	connection = [self _connectedTransferConnectionForTransfer:transfer error:&error];
+	
+	if(!connection) {
+		/* Other streams are still running, let them finish the work */
+		if([transfer numberOfStreams] > 1)
+			error = NULL;
+		
+		[self _finishDownloadStream:NULL forTransfer:transfer error:error];
+		
+		return;
+	}
+	
+	[transfer addStreamConnection:connection];
+	
+	[[[connection socket] socket] setInteractive:NO];
+	
+	stream = [[_WCTransfersStream alloc] init];
+	stream->connection = [connection retain];
+	
+	[self _requestDownloadStream:stream forTransfer:transfer];
+	
+	[stream release];
+}
+
+
+
+- (void)_requestDownloadStream:(_WCTransfersStream *)stream forTransfer:(WCTransfer *)transfer {
+	WCFile			*file;
+	WCError			*error;
+	
+	error = NULL;
+	file = [transfer isTerminating] ? NULL : [transfer claimNextUntransferredFile];
+	
+	if(!file) {
+		[self _finishDownloadStream:stream forTransfer:transfer error:NULL];
+		
+		return;
+	}
+	
+	[self _verifyPartialFile:file forTransfer:transfer];
+	
+	if(![self _sendDownloadFileMessageOnConnection:stream->connection forFile:file error:&error]) {
+		[transfer unclaimFile:file];
+		
+		if(![transfer isTerminating])
+			[transfer setState:WCTransferDisconnecting];
+		
+		[self _finishDownloadStream:stream forTransfer:transfer error:error];
+		
+		return;
+	}
+	
+	[file retain];
+	[stream->file release];
+	
+	stream->file = file;
+	
+	[_transferPool parkJobWithTarget:self
+							selector:@selector(_resumeDownloadStream:stream:)
+							transfer:transfer
+							  object:stream
+							  socket:[[stream->connection socket] socket]];
+}
+
+
+
+- (void)_resumeDownloadStream:(WCTransfer *)transfer stream:(_WCTransfersStream *)stream {
+	WIP7Message			*message;
+	WCError				*error;
+	
+	error = NULL;
+	message = [self _runConnection:stream->connection
+					   forTransfer:transfer
+		 untilReceivingMessageName:@"wired.transfer.download"
+							orIdle:YES
+							 error:&error];
+	
+	if(!message && !error && [transfer isWorking]) {
+		[_transferPool parkJobWithTarget:self
+								selector:@selector(_resumeDownloadStream:stream:)
+								transfer:transfer
+								  object:stream
+								  socket:[[stream->connection socket] socket]];
+		
+		return;
+	}
+	
+	if(!message) {
+		[transfer unclaimFile:stream->file];
+		
+		if(![transfer isTerminating])
+			[transfer setState:WCTransferDisconnecting];
+		
+		[self _finishDownloadStream:stream forTransfer:transfer error:error];
+		
+		return;
+	}
+	
+	if(![self _runDownloadOfFile:stream->file withMessage:message onConnection:stream->connection forTransfer:transfer error:&error]) {
+		[transfer unclaimFile:stream->file];
+		
+		[self _finishDownloadStream:stream forTransfer:transfer error:error];
+		
+		return;
+	}
+	
+	[self performSelectorOnMainThread:@selector(_finishFile:forTransfer:)
+						   withObject:stream->file
+						   withObject:transfer];
+	
+	[self _requestDownloadStream:stream forTransfer:transfer];
+}
+
+
+
+- (void)_finishDownloadStream:(_WCTransfersStream *)stream forTransfer:(WCTransfer *)transfer error:(WCError *)error {
+	if(stream) {
+		[transfer removeStreamConnection:stream->connection];
+		
+		if(!error && ![transfer isTerminating])
+			[self _releaseTransferConnection:stream->connection];
+		else
+			[stream->connection disconnect];
+	}
+	
+	if([transfer endStreamWithError:error] == 0) {
+		[transfer signalTerminated];
+		
+		if([transfer streamError]) {
+			[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
+								   withObject:transfer
+								   withObject:[transfer streamError]];
+		} else {
+			[self performSelectorOnMainThread:@selector(_finishTransfer:)
+								   withObject:transfer];
+		}
+	}
 }
 
 
 
 - (void)_runUpload:(WCTransfer *)transfer {
-	NSAutoreleasePool			*pool;
-	NSProgressIndicator			*progressIndicator;
-	NSString					*dataPath, *rsrcPath;
-	WIP7Socket					*socket;
-	WIP7Message					*message;
 	WCTransferConnection		*connection;
 	WCFile						*file;
 	WCError						*error;
-	char						buffer[8192];
-	NSTimeInterval				time, speedTime, statsTime;
-	NSUInteger					i, sendBytes, speedBytes, statsBytes;
-	WIP7UInt64					dataLength, rsrcLength;
-	WIP7UInt64					dataOffset, rsrcOffset;
-	double						percent;
-	ssize_t						readBytes;
-	int							dataFD, rsrcFD;
-	BOOL						data;
 	
 	error = NULL;
 	connection = [transfer transferConnection];
 	
 	if(!connection) {
-		connection = [self _transferConnectionForTransfer:transfer];
+		connection = [self _connectedTransferConnectionForTransfer:transfer error:&error];
 		
-		if(![self _connectConnection:connection forTransfer:transfer error:&error]) {
+		if(!connection) {
 			if(![transfer isTerminating]) {
 				[transfer setState:WCTransferDisconnecting];
 				[transfer signalTerminated];
@@ -1646,19 +2490,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		[transfer setTransferConnection:connection];
 	}
 	
-	file				= [transfer firstUntransferredFile];
-	dataPath			= [file transferLocalPath];
-	rsrcPath			= [NSFileManager resourceForkPathForPath:dataPath];
-	speedBytes			= 0;
-	statsBytes			= 0;
-	i					= 0;
-	socket				= [connection socket];
-	speedTime			= _WCTransfersTimeInterval();
-	statsTime			= _WCTransfersTimeInterval();
-	progressIndicator	= [transfer progressIndicator];
-	data				= YES;
-	
-	[[socket socket] setInteractive:NO];
+	[[[connection socket] socket] setInteractive:NO];
 	
 	if(![self _createRemainingDirectoriesOnConnection:connection forTransfer:transfer error:&error]) {
 		if(![transfer isTerminating]) {
@@ -1672,8 +2504,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		
 		return;
 	}
-
-	if(![self _sendUploadFileMessageOnConnection:connection forFile:file error:&error]) {
+	
+	if(![self _deleteReplacedFilesOnConnection:connection forTransfer:transfer error:&error]) {
 		if(![transfer isTerminating]) {
 			[transfer setState:WCTransferDisconnecting];
 			[transfer signalTerminated];
@@ -1686,29 +2518,65 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		return;
 	}
 	
-	message = [self _runConnection:connection
-					   forTransfer:transfer
-		 untilReceivingMessageName:@"wired.transfer.upload_ready"
-							 error:&error];
+	file = [transfer firstUntransferredFile];
 	
-	if(!message) {
+	if(!file) {
+		[self performSelectorOnMainThread:@selector(_finishTransfer:) withObject:transfer];
+		
+		return;
+	}
+
+	if(![self _sendUploadFileMessageOnConnection:connection forFile:file transaction:WCTransfersUploadTransaction error:&error]) {
 		if(![transfer isTerminating]) {
 			[transfer setState:WCTransferDisconnecting];
 			[transfer signalTerminated];
 		}
 		
-		if(error) {
-			[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-								   withObject:transfer
-								   withObject:error];
-		} else {
-			[self performSelectorOnMainThread:@selector(_finishTransfer:)
-								   withObject:transfer];
-		}
+		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
+							   withObject:transfer
+							   withObject:error];
 		
 		return;
 	}
 	
+	[_transferPool parkJobWithTarget:self
+							selector:@selector(_resumeUpload:)
+							transfer:transfer
+							  socket:[[connection socket] socket]];
+}
+
+
+
+- (BOOL)_runUploadOfFile:(WCFile *)file withMessage:(WIP7Message *)message onConnection:(WCTransferConnection *)connection forTransfer:(WCTransfer *)transfer error:(WCError **)error {
+	NSAutoreleasePool			*pool;
+	NSString					*dataPath, *rsrcPath;
+	WIP7Socket					*socket;
+	WCTransferReader			*reader;
+	void						*buffer;
+	NSTimeInterval				time, speedTime, statsTime, writeTime, threadTime, framingTime, CPUTime, interval;
+	NSUInteger					i, sendBytes, speedBytes, statsBytes, chunkSize, burstSize;
+	WIP7UInt64					dataLength, rsrcLength;
+	WIP7UInt64					dataOffset, rsrcOffset;
+	NSInteger					readBytes, readOffset;
+	int							dataFD, rsrcFD;
+	BOOL						data;
+	
+	*error				= NULL;
+	chunkSize			= WIMax([transfer chunkSize], WCTransfersMinimumChunkSize);
+	framingTime			= 0.0;
+	interval			= ([transfer roundTripTime] > 0.0) ? WIMin(WIMax([transfer roundTripTime], 0.01), 0.25) : 0.05;
+	dataPath			= [file transferLocalPath];
+	rsrcPath			= [NSFileManager resourceForkPathForPath:dataPath];
+	speedBytes			= 0;
+	statsBytes			= 0;
+	i					= 0;
+	socket				= [connection socket];
+	speedTime			= WCTimeInterval();
+	statsTime			= WCTimeInterval();
+	readBytes			= 0;
+	readOffset			= 0;
+	data				= YES;
+	
 	[message getUInt64:&dataOffset forName:@"wired.transfer.data_offset"];
 	[message getUInt64:&rsrcOffset forName:@"wired.transfer.rsrc_offset"];
 	
@@ -1717,25 +2585,19 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	if([file dataTransferred] == 0) {
 		[file setDataTransferred:dataOffset];
-		[transfer setDataTransferred:[transfer dataTransferred] + dataOffset];
+		[transfer addDataTransferred:dataOffset];
 	}
 	
 	if([file rsrcTransferred] == 0) {
 		[file setRsrcTransferred:rsrcOffset];
-		[transfer setRsrcTransferred:[transfer rsrcTransferred] + rsrcOffset];
+		[transfer addRsrcTransferred:rsrcOffset];
 	}
 	
-	if(![self _sendUploadMessageOnConnection:connection forFile:file dataLength:dataLength rsrcLength:rsrcLength error:&error]) {
-		if(![transfer isTerminating]) {
+	if(![self _sendUploadMessageOnConnection:connection forFile:file dataLength:dataLength rsrcLength:rsrcLength error:error]) {
+		if(![transfer isTerminating])
 			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
-		
-		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-							   withObject:transfer
-							   withObject:error];
 		
-		return;
+		return NO;
 	}
 	
 	dataFD = open([dataPath fileSystemRepresentation], O_RDONLY, 0666);
@@ -1743,12 +2605,10 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	if((dataFD < 0 || lseek(dataFD, [file dataTransferred], SEEK_SET) < 0) ||
 	   (rsrcFD < 0 || lseek(rsrcFD, [file rsrcTransferred], SEEK_SET) < 0)) {
-		error = [WCError errorWithDomain:NSPOSIXErrorDomain code:errno];
+		*error = [WCError errorWithDomain:NSPOSIXErrorDomain code:errno];
 		
-		if(![transfer isTerminating]) {
+		if(![transfer isTerminating])
 			[transfer setState:WCTransferDisconnecting];
-			[transfer signalTerminated];
-		}
 		
 		if(dataFD >= 0)
 			close(dataFD);
@@ -1756,77 +2616,100 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		if(rsrcFD >= 0)
 			close(rsrcFD);
 		
-		[self performSelectorOnMainThread:@selector(_finishTransfer:withError:)
-							   withObject:transfer
-							   withObject:error];
-		
-		return;
+		return NO;
 	}
 
+	reader = [[WCTransferReader alloc] initWithDataDescriptor:dataFD
+												  dataLength:dataLength
+											  rsrcDescriptor:rsrcFD
+												  rsrcLength:rsrcLength
+												  bufferSize:[WCTransferReader defaultBufferSize]
+												 bufferCount:[WCTransferReader defaultBufferCount]];
+
 	if(![transfer isTerminating]) {
 		[transfer setState:WCTransferRunning];
 		
 		[self performSelectorOnMainThread:@selector(_validate)];
 	}
 	
-	wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, 0, speedTime);
+	[transfer addSpeedBytes:0 atTime:speedTime];
+	
+	[[WCTransferScheduler scheduler] addTransfer:transfer weight:1.0];
+	
+	burstSize = [[WCTransferScheduler scheduler] burstSizeForTransfer:transfer];
+	CPUTime = WCThreadTime();
 
 	pool = [[NSAutoreleasePool alloc] init];
 
 	while(![transfer isTerminating]) {
-		if(data && dataLength == 0)
-			data = NO;
-		
-		if(!data && rsrcLength == 0)
+		if(dataLength == 0 && rsrcLength == 0)
 			break;
 		
-		readBytes = read(data ? dataFD : rsrcFD, buffer, sizeof(buffer));
+		if(readOffset == readBytes) {
+			if(readBytes > 0)
+				[reader releaseBuffer];
+			
+			readBytes = [reader readBuffer:&buffer dataFork:&data];
+			readOffset = 0;
 
-		if(readBytes <= 0) {
-			if(readBytes < 0)
-				error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
+			if(readBytes <= 0) {
+				if(readBytes < 0 && [reader fileChanged])
+					*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFileChanged argument:[file name]];
+				else if(readBytes < 0)
+					*error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferFailed argument:[transfer name]];
 
-			if(![transfer isTerminating])
-				[transfer setState:WCTransferDisconnecting];
-			
-			break;
+				if(![transfer isTerminating])
+					[transfer setState:WCTransferDisconnecting];
+				
+				break;
+			}
 		}
 		
-		if(data)
-			sendBytes = (dataLength < (NSUInteger) readBytes) ? dataLength : (NSUInteger) readBytes;
-		else
-			sendBytes = (rsrcLength < (NSUInteger) readBytes) ? rsrcLength : (NSUInteger) readBytes;
+		sendBytes = WIMin((NSUInteger) (readBytes - readOffset), WIMin(chunkSize, burstSize));
+		
+		[[WCTransferScheduler scheduler] waitForBytes:sendBytes forTransfer:transfer];
 		
-		if(![socket writeOOBData:buffer length:sendBytes timeout:30.0 error:&error]) {
+		writeTime = WCTimeInterval();
+		threadTime = WCThreadTime();
+		
+		if(![socket writeOOBData:(char *) buffer + readOffset length:sendBytes timeout:30.0 error:error]) {
 			[transfer setState:WCTransferDisconnecting];
 
 			break;
 		}
+		
+		framingTime += WCThreadTime() - threadTime;
+		
+		if(i == 0)
+			[transfer setFirstByteTime:writeTime];
 
 		if(data) {
 			dataLength					-= sendBytes;
-			transfer->_dataTransferred	+= sendBytes;
 			file->_dataTransferred		+= sendBytes;
+			
+			[transfer addDataTransferred:sendBytes];
 		} else {
 			rsrcLength					-= sendBytes;
-			transfer->_rsrcTransferred	+= sendBytes;
 			file->_rsrcTransferred		+= sendBytes;
+			
+			[transfer addRsrcTransferred:sendBytes];
 		}
 		
-		transfer->_actualTransferred	+= readBytes;
+		readOffset						+= sendBytes;
 		speedBytes						+= sendBytes;
 		statsBytes						+= sendBytes;
-		percent							= (transfer->_dataTransferred + transfer->_rsrcTransferred) / (double) transfer->_size;
-		time							= _WCTransfersTimeInterval();
+		time							= WCTimeInterval();
 		
-		if(percent == 1.00 || percent - [progressIndicator doubleValue] >= 0.001)
-			[progressIndicator setDoubleValue:percent];
+		if(sendBytes == chunkSize && time - writeTime < interval / 2.0 && chunkSize < WCTransfersMaximumChunkSize)
+			chunkSize *= 2;
+		else if(time - writeTime > interval * 2.0 && chunkSize > WCTransfersMinimumChunkSize)
+			chunkSize /= 2;
 		
 		if(transfer->_speed == 0.0 || time - speedTime > 0.33) {
-			wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, speedBytes, speedTime);
-			
-			transfer->_speed = wi_speed_calculator_speed(transfer->_speedCalculator);
+			[transfer addSpeedBytes:speedBytes atTime:speedTime];
+			[transfer setChunkSize:chunkSize];
 			
+			burstSize = [[WCTransferScheduler scheduler] burstSizeForTransfer:transfer];
 			speedBytes = 0;
 			speedTime = time;
 		}
@@ -1844,16 +2727,136 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		}
 	}
 	
+	[[WCTransferScheduler scheduler] removeTransfer:transfer];
+	
+	[reader close];
+	[transfer addReadStallTime:[reader readStallTime] writeStallTime:[reader writeStallTime]];
+	[reader release];
+	
 	close(dataFD);
 	close(rsrcFD);
 	
-	wi_speed_calculator_add_bytes_at_time(transfer->_speedCalculator, speedBytes, speedTime);
-	
-	transfer->_speed = wi_speed_calculator_speed(transfer->_speedCalculator);
+	[transfer addSpeedBytes:speedBytes atTime:speedTime];
+	[transfer setChunkSize:chunkSize];
+	[transfer addFramingTime:framingTime];
+	[transfer addCPUTime:WCThreadTime() - CPUTime];
 	
 	if(statsBytes > 0)
-		[[WCStats stats] addUnsignedLongLong:statsBytes forKey:WCStatsDownloaded];
+		[[WCStats stats] addUnsignedLongLong:statsBytes forKey:WCStatsUploaded];
+	
+	[*error retain];
+	[pool release];
+	[*error autorelease];
+	
+	return (dataLength == 0 && rsrcLength == 0 && !*error);
+}
 
+
+
+- (void)_resumeUpload:(WCTransfer *)transfer {
+	struct _WCTransfersUploadRequest	*requests;
+	WIP7Message							*message;
+	WCTransferConnection				*connection;
+	WCFile								*file, *lastFile, *nextFile;
+	WCError								*error;
+	NSUInteger							i, count, window;
+	WIP7UInt32							transaction, nextTransaction;
+	BOOL								failed;
+	
+	error				= NULL;
+	connection			= [transfer transferConnection];
+	file				= [transfer firstUntransferredFile];
+	window				= WIMax([[WCSettings settings] integerForKey:WCTransferUploadPipelineWindow], 1);
+	
+	message = [self _runConnection:connection
+					   forTransfer:transfer
+		 untilReceivingMessageName:@"wired.transfer.upload_ready"
+							orIdle:YES
+							 error:&error];
+	
+	if(!message && !error && [transfer isWorking]) {
+		[_transferPool parkJobWithTarget:self
+								selector:@selector(_resumeUpload:)
+								transfer:transfer
+								  socket:[[connection socket] socket]];
+		
+		return;
+	}
+	
+	requests					= malloc(window * sizeof(struct _WCTransfersUploadRequest));
+	requests[0].file			= [file retain];
+	requests[0].transaction		= WCTransfersUploadTransaction;
+	requests[0].time			= 0.0;
+	count						= 1;
+	lastFile					= file;
+	nextTransaction				= WCTransfersUploadTransaction + 1;
+	failed						= NO;
+	
+	while(message) {
+		if(![message getUInt32:&transaction forName:@"wired.transaction"])
+			transaction = requests[0].transaction;
+		
+		for(i = 0; i < count; i++) {
+			if(requests[i].transaction == transaction)
+				break;
+		}
+		
+		if(i < count) {
+			file = [requests[i].file autorelease];
+			
+			if(requests[i].time > 0.0)
+				[transfer setRoundTripTime:WCTimeInterval() - requests[i].time];
+			
+			memmove(&requests[i], &requests[i + 1], (count - i - 1) * sizeof(struct _WCTransfersUploadRequest));
+			count--;
+			
+			while(count < window && ![transfer isTerminating]) {
+				nextFile = [transfer untransferredFileAfterFile:lastFile];
+				
+				if(!nextFile)
+					break;
+				
+				if(![self _sendUploadFileMessageOnConnection:connection forFile:nextFile transaction:nextTransaction error:&error]) {
+					failed = YES;
+					
+					break;
+				}
+				
+				requests[count].file			= [nextFile retain];
+				requests[count].transaction		= nextTransaction++;
+				requests[count].time			= WCTimeInterval();
+				lastFile						= nextFile;
+				count++;
+			}
+			
+			if(failed)
+				break;
+			
+			if(![self _runUploadOfFile:file withMessage:message onConnection:connection forTransfer:transfer error:&error])
+				break;
+			
+			if(count == 0 || [transfer isTerminating])
+				break;
+			
+			[self performSelectorOnMainThread:@selector(_finishFile:forTransfer:)
+								   withObject:file
+								   withObject:transfer];
+		}
+		
+		message = [self _runConnection:connection
+						   forTransfer:transfer
+			 untilReceivingMessageName:@"wired.transfer.upload_ready"
+								 error:&error];
+	}
+	
+	for(i = 0; i < count; i++)
+		[requests[i].file release];
+	
+	free(requests);
+	
+	if((!message || failed) && ![transfer isTerminating])
+		[transfer setState:WCTransferDisconnecting];
+	
 	[transfer signalTerminated];
 	
 	if(error) {
@@ -1864,8 +2867,6 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		[self performSelectorOnMainThread:@selector(_finishTransfer:)
 							   withObject:transfer];
 	}
-	
-	[pool release];
 }
 
 @end
@@ -1896,12 +2897,22 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	_sizeFormatter			= [[WISizeFormatter alloc] init];
 	_timeIntervalFormatter	= [[WITimeIntervalFormatter alloc] init];
+	
+	_transferPool			= [[WCTransferPool alloc] initWithSize:[WCTransferPool defaultSize]];
+	_connectionPool			= [[WCTransferConnectionPool alloc] initWithIdleTimeout:[WCTransferConnectionPool defaultIdleTimeout]];
+	_journal				= [[WCTransferJournal alloc] initWithPath:[WCTransfersJournalPath stringByStandardizingPath]];
+	_queue					= [[WCTransferQueue alloc] init];
 
 	[[NSNotificationCenter defaultCenter]
 		addObserver:self
 		   selector:@selector(applicationWillTerminate:)
 			   name:NSApplicationWillTerminateNotification];
 
+	[[NSNotificationCenter defaultCenter]
+		addObserver:self
+		   selector:@selector(preferencesDidChange:)
+			   name:WCPreferencesDidChangeNotification];
+
 	[[NSNotificationCenter defaultCenter]
 		addObserver:self
 		   selector:@selector(selectedThemeDidChange:)
@@ -1937,7 +2948,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		   selector:@selector(serverConnectionPrivilegesDidChange:)
 			   name:WCServerConnectionPrivilegesDidChangeNotification];
 
-	_timer = [NSTimer scheduledTimerWithTimeInterval:0.33
+	_timer = [NSTimer scheduledTimerWithTimeInterval:WCTransfersRefreshInterval
 											  target:self
 											selector:@selector(updateTimer:)
 											userInfo:NULL
@@ -1962,6 +2973,11 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	[_sizeFormatter release];
 	[_timeIntervalFormatter release];
+	
+	[_transferPool release];
+	[_connectionPool release];
+	[_journal release];
+	[_queue release];
 
 	[super dealloc];
 }
@@ -1993,13 +3009,18 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	[_transfersTableView registerForDraggedTypes:
 		[NSArray arrayWithObjects:NSStringPboardType, WCTransferPboardType, NULL]];
 
-    data = [[WCSettings settings] objectForKey:WCTransferList];
-
-    if(data)
-        _transfers = [[NSKeyedUnarchiver unarchiveObjectWithData:data] retain];
+	_transfers = [[_journal readTransfers] retain];
 	
-	if(!_transfers)
-		_transfers = [[NSMutableArray alloc] init];
+	if([_transfers count] == 0) {
+		data = [[WCSettings settings] objectForKey:WCTransferList];
+		
+		if(data) {
+			[_transfers addObjectsFromArray:[NSKeyedUnarchiver unarchiveObjectWithData:data]];
+			[_journal compactWithTransfers:_transfers];
+			
+			[[NSUserDefaults standardUserDefaults] removeObjectForKey:WCTransferList];
+		}
+	}
 	
 	enumerator = [_transfers objectEnumerator];
 	
@@ -2163,6 +3184,25 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (void)preferencesDidChange:(NSNotification *)notification {
+	NSEnumerator				*enumerator;
+	WCPublicChatController		*chatController;
+	
+	[_transferPool setSize:[WCTransferPool defaultSize]];
+	[_connectionPool setIdleTimeout:[WCTransferConnectionPool defaultIdleTimeout]];
+	
+	[self _rebuildQueue];
+	
+	enumerator = [[[WCPublicChat publicChat] chatControllers] objectEnumerator];
+	
+	while((chatController = [enumerator nextObject])) {
+		if([[chatController connection] isConnected])
+			[self _requestNextTransferForConnection:[chatController connection]];
+	}
+}
+
+
+
 - (void)linkConnectionLoggedIn:(NSNotification *)notification {
 	NSEnumerator			*enumerator;
 	WCServerConnection		*connection;
@@ -2178,10 +3218,18 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		if([transfer belongsToConnection:connection])
 			[transfer setConnection:connection];
 		
-		if([transfer connection] == connection && [transfer state] == WCTransferDisconnected)
-			[self _requestTransfer:transfer];
+		if([transfer connection] == connection) {
+			if([transfer state] == WCTransferDisconnected) {
+				[[WCStats stats] addReconnectForTransfer:[transfer identifier] server:[[connection URL] hostpair]];
+				
+				[self _requestTransfer:transfer];
+			} else if([transfer state] == WCTransferLocallyQueued)
+				[_queue addTransfer:transfer policy:[self _queuePolicyForConnection:connection]];
+		}
 	}
 	
+	[self _requestNextTransferForConnection:connection];
+	
 	[_transfersTableView setNeedsDisplay:YES];
 	[_transfersTableView reloadData];
 	
@@ -2249,6 +3297,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			[transfer refreshSpeedLimit];
 	}
 	
+	[[WCTransferScheduler scheduler] refreshLimits];
+	
 	[_transfersTableView setNeedsDisplay:YES];
 }
 
@@ -2267,6 +3317,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			[transfer refreshSpeedLimit];
 	}
 	
+	[[WCTransferScheduler scheduler] refreshLimits];
+	
 	[_transfersTableView setNeedsDisplay:YES];
 }
 
@@ -2279,9 +3331,10 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 - (void)wiredFileListPathReply:(WIP7Message *)message {
-	NSString			*rootPath, *localPath;
+	NSString			*rootPath, *localPath, *change;
 	WCTransfer			*transfer;
 	WCFile				*file;
+	WCError				*error;
 	NSRect				rect;
 	WIP7UInt32			transaction;
 	
@@ -2304,38 +3357,74 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			
 			if([file type] == WCFileFile) {
 				if(![transfer containsTransferredFile:file] && ![transfer containsUntransferredFile:file]) {
-					if([[NSFileManager defaultManager] fileExistsAtPath:localPath]) {
-						[transfer setDataTransferred:[transfer dataTransferred] + [file dataSize]];
-						[transfer setRsrcTransferred:[transfer rsrcTransferred] + [file rsrcSize]];
-					} else {
-						[transfer setSize:[transfer size] + [file dataSize] + [file rsrcSize]];
-						
-						if(![localPath hasSuffix:WCTransfersFileExtension])
-							localPath = [localPath stringByAppendingPathExtension:WCTransfersFileExtension];
-						
-						[file setDataTransferred:[[NSFileManager defaultManager] fileSizeAtPath:localPath]];
-						
-						if([[file connection] supportsResourceForks])
-							[file setRsrcTransferred:[[NSFileManager defaultManager] resourceForkSizeAtPath:localPath]];
-						
-						[file setTransferLocalPath:localPath];
-						
-						[transfer addUntransferredFile:file];
-						[transfer setDataTransferred:[transfer dataTransferred] + [file dataTransferred]];
-						[transfer setRsrcTransferred:[transfer rsrcTransferred] + [file rsrcTransferred]];
+					change = [transfer isSync] ? _WCTransfersSyncChange(file, localPath, YES) : NULL;
+					
+					if(change) {
+						[transfer addSyncChange:[NSSWF:@"%@: %@", change, [file path]]
+										   size:[file dataSize] + [file rsrcSize]];
+					}
+					
+					if(![transfer isDryRun]) {
+						if([[NSFileManager defaultManager] fileExistsAtPath:localPath] && !change) {
+							[transfer addDataTransferred:[file dataSize]];
+							[transfer addRsrcTransferred:[file rsrcSize]];
+						} else {
+							[transfer setSize:[transfer size] + [file dataSize] + [file rsrcSize]];
+							
+							if(![localPath hasSuffix:WCTransfersFileExtension])
+								localPath = [localPath stringByAppendingPathExtension:WCTransfersFileExtension];
+							
+							[file setDataTransferred:[[NSFileManager defaultManager] fileSizeAtPath:localPath]];
+							
+							if([[file connection] supportsResourceForks])
+								[file setRsrcTransferred:[[NSFileManager defaultManager] resourceForkSizeAtPath:localPath]];
+							
+							[file setTransferLocalPath:localPath];
+							
+							[transfer addUntransferredFile:file];
+							[transfer addDataTransferred:[file dataTransferred]];
+							[transfer addRsrcTransferred:[file rsrcTransferred]];
+							
+							if(![transfer isTerminating] &&
+							   [transfer beginAdditionalStreamWithLimit:[self _numberOfStreamsForTransfer:transfer]])
+								[_transferPool addJobWithTarget:self selector:@selector(_runDownloadStream:) transfer:transfer];
+						}
 					}
 				}
 			} else {
-				if(![transfer containsUncreatedDirectory:file] && ![transfer containsCreatedDirectory:file])
-					[transfer addUncreatedDirectory:file];
+				if(![transfer containsUncreatedDirectory:file] && ![transfer containsCreatedDirectory:file]) {
+					if([transfer isWorking] && [transfer state] != WCTransferListing) {
+						[[NSFileManager defaultManager] createDirectoryAtPath:localPath];
+						
+						[transfer addCreatedDirectory:file];
+					} else {
+						[transfer addUncreatedDirectory:file];
+					}
+				}
 			}
+			
+			if([transfer state] == WCTransferListing && [transfer numberOfUntransferredFiles] > 0)
+				[self _startTransfer:transfer first:([transfer numberOfTransferredFiles] == 0)];
 		} else {
-			if([file type] == WCFileFile) {
+			change = NULL;
+			
+			if([file type] == WCFileFile && [transfer isSync] && [transfer containsUntransferredFile:file]) {
+				localPath = [[transfer localPath] stringByAppendingPathComponent:
+					[[file path] substringFromIndex:[[transfer remotePath] length]]];
+				change = _WCTransfersSyncChange(file, localPath, NO);
+			}
+			
+			if(change) {
+				[transfer addSyncChange:[NSSWF:@"%@: %@", change, [file path]]
+								   size:[[NSFileManager defaultManager] fileSizeAtPath:localPath]];
+				[transfer addReplacedPath:[file path]];
+			}
+			else if([file type] == WCFileFile) {
 				if([transfer containsUntransferredFile:file])
 					[transfer removeUntransferredFile:file];
 				
 				if(![transfer containsTransferredFile:file]) {
-					[transfer setDataTransferred:[transfer dataTransferred] + [file dataSize] + [file rsrcSize]];
+					[transfer addDataTransferred:[file dataSize] + [file rsrcSize]];
 					[transfer removeUntransferredFile:file];
 				}
 			} else {
@@ -2347,7 +3436,7 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 			}
 		}
 		
-		if([[transfer uncreatedDirectories] count] + [[transfer createdDirectories] count] % 10 == 0 ||
+		if([transfer numberOfUncreatedDirectories] + [transfer numberOfCreatedDirectories] % 10 == 0 ||
 		   [transfer numberOfUntransferredFiles] + [transfer numberOfTransferredFiles] % 10 == 0) {
 			rect = [_transfersTableView frameOfCellAtColumn:1 row:[_transfers indexOfObject:transfer]];
 
@@ -2355,17 +3444,31 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		}
 	}
 	else if([[message name] isEqualToString:@"wired.file.file_list.done"]) {
-		if([transfer numberOfUntransferredFiles] > 0) {
-			[self _startTransfer:transfer first:YES];
-		} else {
-			[self _createRemainingDirectoriesForTransfer:transfer];
-			[self _finishTransfer:transfer];
+		[transfer setListing:NO];
+		
+		if([transfer isSync])
+			[self _reportSyncForTransfer:transfer];
+		
+		if([transfer state] == WCTransferListing) {
+			if([transfer numberOfUntransferredFiles] > 0) {
+				[self _startTransfer:transfer first:YES];
+			} else {
+				[self _createRemainingDirectoriesForTransfer:transfer];
+				[self _finishTransfer:transfer];
+			}
 		}
 		
 		[[transfer connection] removeObserver:self message:message];
 	}
 	else if([[message name] isEqualToString:@"wired.error"]) {
-		[_errorQueue showError:[WCError errorWithWiredMessage:message]];
+		[transfer setListing:NO];
+		
+		error = [WCError errorWithWiredMessage:message];
+		
+		if([transfer isDryRun] && [error code] == WCWiredProtocolFileNotFound)
+			[self _reportSyncForTransfer:transfer];
+		else
+			[_errorQueue showError:error];
 		
 		[[transfer connection] removeObserver:self message:message];
 	}
@@ -2419,6 +3522,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		return [self _validateRevealInFinder];
 	else if(selector == @selector(revealInFiles:))
 		return [self _validateRevealInFiles];
+	else if(selector == @selector(raisePriority:) || selector == @selector(lowerPriority:))
+		return [self _validatePriority];
 	
 	return YES;
 }
@@ -2427,30 +3532,25 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 #pragma mark -
 
-- (void)transferThread:(id)arg {
-	NSAutoreleasePool		*pool;
-	WCTransfer				*transfer = arg;
-	
-	pool = [[NSAutoreleasePool alloc] init];
-	
-	if([transfer isKindOfClass:[WCDownloadTransfer class]])
-		[self _runDownload:transfer];
-	else
-		[self _runUpload:transfer];
-	
-	[pool release];
-}
-
-
-
 - (void)updateTimer:(NSTimer *)timer {
+	WCTransfer		*transfer;
 	NSRect			rect;
+	NSRange			range;
 	NSUInteger		i, count;
 	
+	if([NSDate timeIntervalSinceReferenceDate] - _statsTime >= 1.0) {
+		[self _sampleStats];
+		
+		_statsTime = [NSDate timeIntervalSinceReferenceDate];
+	}
+	
 	count = [_transfers count];
+	range = [_transfersTableView rowsInRect:[_transfersTableView visibleRect]];
 	
-	for(i = 0; i < count; i++) {
-		if([[_transfers objectAtIndex:i] isWorking]) {
+	for(i = range.location; i < NSMaxRange(range) && i < count; i++) {
+		transfer = [_transfers objectAtIndex:i];
+		
+		if([transfer isWorking] && [transfer refreshProgress]) {
 			rect = [_transfersTableView frameOfCellAtColumn:1 row:i];
 
 			[_transfersTableView setNeedsDisplayInRect:rect];
@@ -2537,6 +3637,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		[_transfers addObject:transfer];
 		[_transfersTableView reloadData];
 		
+		[self _saveTransfer:transfer];
+		
 		index = [_transfers count] - 1;
 	}
 	
@@ -2567,6 +3669,52 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (BOOL)syncFiles:(NSArray *)files dryRun:(BOOL)dryRun {
+	NSEnumerator	*enumerator;
+	NSString		*destination;
+	WCFile			*file;
+	WCError			*error;
+	BOOL			result = NO;
+	
+	destination = [[[WCSettings settings] objectForKey:WCDownloadFolder] stringByStandardizingPath];
+	
+	if(![[NSFileManager defaultManager] directoryExistsAtPath:destination]) {
+		error = [WCError errorWithDomain:WCWiredClientErrorDomain code:WCWiredClientTransferDownloadDirectoryNotFound argument:destination];
+		
+		[self _presentError:error forConnection:[[files objectAtIndex:0] connection] transfer:NULL];
+		
+		return NO;
+	}
+	
+	enumerator = [files objectEnumerator];
+	
+	while((file = [enumerator nextObject])) {
+		if([file isFolder] && [self _downloadFile:file toFolder:destination sync:YES dryRun:dryRun])
+			result = YES;
+	}
+	
+	return result;
+}
+
+
+
+- (BOOL)syncPaths:(NSArray *)paths toFolder:(WCFile *)destination dryRun:(BOOL)dryRun {
+	NSEnumerator	*enumerator;
+	NSString		*path;
+	BOOL			result = NO;
+	
+	enumerator = [paths objectEnumerator];
+	
+	while((path = [enumerator nextObject])) {
+		if([[NSFileManager defaultManager] directoryExistsAtPath:path] && [self _uploadPath:path toFolder:destination sync:YES dryRun:dryRun])
+			result = YES;
+	}
+	
+	return result;
+}
+
+
+
 #pragma mark -
 
 - (IBAction)deleteDocument:(id)sender {
@@ -2585,6 +3733,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	enumerator = [[self _selectedTransfers] objectEnumerator];
 	
 	while((transfer = [enumerator nextObject])) {
+		[_queue removeTransfer:transfer];
+		
 		[transfer setState:WCTransferWaiting];
 		
 		[self _requestTransfer:transfer];
@@ -2609,6 +3759,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	while((transfer = [enumerator nextObject]))
 		[transfer setState:WCTransferPausing];
 	
+	[_transferPool wakeUp];
+	
 	[_transfersTableView setNeedsDisplay:YES];
 
 	[self _validate];
@@ -2627,6 +3779,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 	
 	while((transfer = [enumerator nextObject]))
 		[transfer setState:WCTransferStopping];
+	
+	[_transferPool wakeUp];
 
 	[_transfersTableView setNeedsDisplay:YES];
 
@@ -2650,6 +3804,8 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		else
 			[self _removeTransfer:transfer];
 	}
+	
+	[_transferPool wakeUp];
 
 	[_transfersTableView setNeedsDisplay:YES];
 	[_transfersTableView reloadData];
@@ -2777,6 +3933,52 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (IBAction)raisePriority:(id)sender {
+	NSEnumerator	*enumerator;
+	WCTransfer		*transfer;
+	
+	if(![self _validatePriority])
+		return;
+	
+	enumerator = [[self _selectedTransfers] objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		[transfer setPriority:[transfer priority] + 1];
+		
+		if([_queue containsTransfer:transfer])
+			[_queue addTransfer:transfer policy:[self _queuePolicyForConnection:[transfer connection]]];
+		
+		[self _saveTransfer:transfer];
+	}
+	
+	[_transfersTableView setNeedsDisplay:YES];
+}
+
+
+
+- (IBAction)lowerPriority:(id)sender {
+	NSEnumerator	*enumerator;
+	WCTransfer		*transfer;
+	
+	if(![self _validatePriority])
+		return;
+	
+	enumerator = [[self _selectedTransfers] objectEnumerator];
+	
+	while((transfer = [enumerator nextObject])) {
+		[transfer setPriority:[transfer priority] - 1];
+		
+		if([_queue containsTransfer:transfer])
+			[_queue addTransfer:transfer policy:[self _queuePolicyForConnection:[transfer connection]]];
+		
+		[self _saveTransfer:transfer];
+	}
+	
+	[_transfersTableView setNeedsDisplay:YES];
+}
+
+
+
 #pragma mark -
 
 - (NSInteger)numberOfRowsInTableView:(NSTableView *)tableView {
@@ -2806,6 +4008,12 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 
 
 
+- (NSString *)tableView:(NSTableView *)tableView toolTipForCell:(NSCell *)cell rect:(NSRectPointer)rect tableColumn:(NSTableColumn *)tableColumn row:(NSInteger)row mouseLocation:(NSPoint)mouseLocation {
+	return [self _toolTipForTransfer:[_transfers objectAtIndex:row]];
+}
+
+
+
 - (void)tableViewSelectionDidChange:(NSNotification *)notification {
 	[self _validate];
 }
@@ -2878,6 +4086,10 @@ static inline NSTimeInterval _WCTransfersTimeInterval(void) {
 		fromRow = [[pasteboard stringForType:WCTransferPboardType] integerValue];
 		[_transfers moveObjectAtIndex:fromRow toIndex:row];
 		[_transfersTableView reloadData];
+		
+		[_journal writeOrderOfTransfers:_transfers];
+		
+		[self _rebuildQueue];
 
 		return YES;
 	}